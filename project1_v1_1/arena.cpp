@@ -0,0 +1,103 @@
+#include "arena.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+
+static std::atomic<bool> huge_pages_enabled(true);
+
+void arena_set_huge_pages(bool enabled) {
+    huge_pages_enabled = enabled;
+}
+
+const char *arena_pages_name(arena_pages_t pages) {
+    switch (pages) {
+    case ARENA_PAGES_SMALL:
+        return "small pages";
+    case ARENA_PAGES_TRANSPARENT:
+        return "transparent huge pages";
+    case ARENA_PAGES_HUGETLB:
+        return "2 MB huge pages";
+    default:
+        return "none";
+    }
+}
+
+Arena::~Arena() {
+    release();
+}
+
+void Arena::release() {
+    if (base) {
+        munmap(base, size);
+    }
+    base = nullptr;
+    size = used = dirty = 0;
+    backing = ARENA_PAGES_NONE;
+}
+
+void Arena::reserve(size_t capacity) {
+    used = 0;
+    if (capacity <= size) {
+        return;
+    }
+    release();
+
+    void *p = MAP_FAILED;
+    bool huge = huge_pages_enabled && capacity >= ARENA_HUGE_PAGE;
+    if (huge) {
+        // reserved huge pages first; most systems have none
+        size_t rounded = (capacity + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+        p = mmap(NULL, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            base = (uint8_t *)p;
+            size = rounded;
+            backing = ARENA_PAGES_HUGETLB;
+            return;
+        }
+        // then transparent ones, which want a 2 MB aligned region: map one
+        // huge page extra and trim
+        size_t padded = rounded + ARENA_HUGE_PAGE;
+        p = mmap(NULL, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED) {
+            uintptr_t start = (uintptr_t)p;
+            uintptr_t aligned = (start + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1);
+            if (aligned > start) {
+                munmap(p, aligned - start);
+            }
+            if (start + padded > aligned + rounded) {
+                munmap((void *)(aligned + rounded), start + padded - (aligned + rounded));
+            }
+            base = (uint8_t *)aligned;
+            size = rounded;
+            backing = madvise(base, size, MADV_HUGEPAGE) == 0 ? ARENA_PAGES_TRANSPARENT : ARENA_PAGES_SMALL;
+            return;
+        }
+    }
+    p = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "Error: cannot allocate %zu bytes of simulator state\n", capacity);
+        exit(1);
+    }
+    base = (uint8_t *)p;
+    size = capacity;
+    backing = ARENA_PAGES_SMALL;
+}
+
+void *Arena::alloc(size_t bytes) {
+    size_t take = arena_round(bytes);
+    if (take > size - used) {
+        fprintf(stderr, "Error: arena of %zu bytes is full\n", size);
+        exit(1);
+    }
+    uint8_t *p = base + used;
+    // bytes an earlier use touched are no longer zero
+    if (used < dirty) {
+        memset(p, 0, std::min(take, dirty - used));
+    }
+    used += take;
+    dirty = std::max(dirty, used);
+    return p;
+}
@@ -0,0 +1,69 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// What an arena's memory ended up backed by
+typedef enum arena_pages {
+    // nothing mapped yet
+    ARENA_PAGES_NONE,
+    // ordinary 4 KB pages
+    ARENA_PAGES_SMALL,
+    // transparent huge pages, requested with madvise(MADV_HUGEPAGE)
+    ARENA_PAGES_TRANSPARENT,
+    // reserved 2 MB huge pages (MAP_HUGETLB)
+    ARENA_PAGES_HUGETLB,
+} arena_pages_t;
+
+// Regions at least this large are backed by huge pages, when allowed
+static const size_t ARENA_HUGE_PAGE = 2 << 20;
+
+// Process-wide switch for huge pages in arenas mapped from now on (default
+// on); off, every arena uses small pages
+extern void arena_set_huge_pages(bool enabled);
+extern const char *arena_pages_name(arena_pages_t pages);
+
+// One contiguous anonymous mapping that allocations are carved from in
+// order, 64-byte aligned. Memory comes back zeroed: fresh pages are zero
+// already, and only bytes an earlier use touched are cleared again, so
+// setting up state costs no second pass over untouched memory.
+class Arena {
+public:
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    // Make room for capacity bytes, remapping only if the current mapping
+    // is smaller; also resets. Exits if out of memory, like CacheArray::init.
+    void reserve(size_t capacity);
+    // Forget every allocation in O(1); the mapping stays for the next use
+    void reset() { used = 0; }
+    // Zeroed bytes; exits if the arena is full
+    void *alloc(size_t bytes);
+    template <typename T>
+    T *alloc_array(size_t n) {
+        return static_cast<T *>(alloc(n * sizeof(T)));
+    }
+
+    size_t capacity() const { return size; }
+    arena_pages_t pages() const { return backing; }
+
+private:
+    void release();
+
+    uint8_t *base = nullptr;
+    size_t size = 0;
+    size_t used = 0;
+    // bytes touched since the mapping was made, which are no longer zero
+    size_t dirty = 0;
+    arena_pages_t backing = ARENA_PAGES_NONE;
+};
+
+// Bytes an alloc() of `bytes` takes from an arena
+static inline size_t arena_round(size_t bytes) {
+    return (bytes + 63) & ~(size_t)63;
+}
+
+#endif /* ARENA_HPP */
@@ -0,0 +1,267 @@
+#ifndef CACHE_SIMULATOR_HPP
+#define CACHE_SIMULATOR_HPP
+
+#include "cachesim.hpp"
+#include "instrument.hpp"
+#include "arena.hpp"
+#include <stdio.h>
+#include <vector>
+#include <memory>
+#include <cstdlib>
+#include <string>
+
+// One cache level in structure-of-arrays form. Way w of set s is entry
+// s * ways + w of tags and last_used; valid, dirty and prefetched are
+// bitmasks of `words` 64-bit words per set. Everything lives in one
+// 64-byte-aligned block of the simulator's arena, so a set's tags can be
+// compared with aligned vector loads.
+struct CacheArray {
+    uint64_t sets = 0;
+    uint64_t ways = 0;
+    uint64_t words = 0;
+    uint64_t *tags = nullptr;
+    uint64_t *last_used = nullptr;
+    uint64_t *valid = nullptr;
+    uint64_t *dirty = nullptr;
+    uint64_t *prefetched = nullptr;
+    // size of storage, in words
+    uint64_t storage_words = 0;
+    uint64_t *storage = nullptr;
+
+    // Words of storage n_sets x n_ways blocks take
+    static uint64_t words_for(uint64_t n_sets, uint64_t n_ways);
+    // Carve n_sets x n_ways invalid blocks out of arena
+    void init(Arena &arena, uint64_t n_sets, uint64_t n_ways);
+};
+
+// Markov Prefetcher State
+struct MarkovEntry {
+    uint64_t count;
+    uint64_t next_block_addr;
+};
+static const uint32_t MARKOV_ENTRIES = 4;
+static const uint32_t MARKOV_NONE = UINT32_MAX;
+static const uint64_t MARKOV_MAX_ROWS = 1ULL << 30;
+// Words in the fixed-width encoding of a sim_config_t (pack_config)
+static const size_t SIM_CONFIG_WORDS = 16;
+// Bump whenever a change alters simulation results, so results stored by
+// older builds are never reused (see result_cache.hpp)
+static const uint32_t SIM_RESULTS_VERSION = 1;
+// Independent sub-samples the set-sampling error bars are computed from
+static const unsigned SAMPLE_MAX_BUCKETS = 32;
+// One row of the fixed-size Markov table: the successors of block_addr,
+// plus its links in the row LRU list (indices into markov_rows)
+struct MarkovRow {
+    uint64_t block_addr = 0;
+    MarkovEntry entries[MARKOV_ENTRIES];
+    uint32_t n_entries = 0;
+    uint32_t prev = MARKOV_NONE;
+    uint32_t next = MARKOV_NONE;
+};
+
+// One complete two-level cache simulation. Instances share nothing, so any
+// number of them can run side by side (one per thread, for example).
+// sim_setup/sim_access/sim_finish drive a single default instance.
+class CacheSimulator {
+public:
+    // Exits with an error message on an invalid configuration, like sim_setup.
+    // specialize = false forces the generic kernel (for benchmarking).
+    // Both cache levels and the Markov table live in one arena: the
+    // simulator's own, or the caller's, which is reset and grown here and
+    // can then be reused (O(1) reset, no remapping) by the next simulator
+    // once this one is gone.
+    explicit CacheSimulator(const sim_config_t &config, bool specialize = true, Arena *arena = nullptr);
+
+    // Returns false, with a message in *error, for a configuration the
+    // constructor would reject
+    static bool check_config(const sim_config_t &config, std::string *error);
+
+    void access(char rw, uint64_t addr, sim_stats_t *stats) {
+        if (sample_l1) {
+            sampled_access(rw, addr, stats);
+            return;
+        }
+        (this->*access_fn)(rw, addr, stats);
+    }
+    // Same as calling access() on each record, in order
+    void access_batch(const access_t *recs, size_t n, sim_stats_t *stats) {
+        if (sample_l1) {
+            sampled_batch(recs, n, stats);
+            return;
+        }
+        (this->*batch_fn)(recs, n, stats);
+    }
+    void finish(sim_stats_t *stats) const;
+
+    // Functional warming: update cache and prefetcher state as
+    // access_batch() would, without counting anything (not even into the
+    // set-sampling buckets)
+    void warm(const access_t *recs, size_t n) {
+        sim_stats_t scratch = sim_stats_t();
+        warming = true;
+        access_batch(recs, n, &scratch);
+        warming = false;
+    }
+    // Time sampling: the accesses counted into stats between the two calls
+    // form one measurement window; end_window() bumps stats->windows
+    void begin_window(const sim_stats_t *stats);
+    void end_window(sim_stats_t *stats);
+    // Estimates with 95% confidence intervals from the per-window counters
+    void window_report(sim_window_stats_t *out) const;
+
+    // Set sampling: simulate only about one in `one_in` L2 sets (L1 sets
+    // if L2 is disabled), chosen by a hash of the set index. Call before the
+    // first access. finish() then extrapolates the counters of that level
+    // from the sampled sets; everything else stays exact. Prefetches into
+    // unsampled sets are dropped, and the Markov table only sees misses in
+    // sampled sets.
+    void sample_sets(uint64_t one_in);
+    // Estimates with 95% confidence intervals, given the finished stats
+    void sample_report(const sim_stats_t *stats, sim_sample_stats_t *out) const;
+    // The sim_finish arithmetic on its own: fills in the ratios and AATs of
+    // stats from its counters for the given configuration
+    static void finish_stats(const sim_config_t &config, sim_stats_t *stats);
+    // Every field of config as SIM_CONFIG_WORDS integers, L1 then L2
+    static void pack_config(const sim_config_t &config, uint64_t *out);
+
+    const sim_config_t &get_config() const { return config; }
+    // What the arena holding the simulator state is backed by
+    arena_pages_t state_pages() const { return arena->pages(); }
+
+    // Checkpoints: the complete simulator state (both cache levels, the
+    // recency counters, the Markov table, set and time sampling) plus
+    // *stats and the caller's trace position, written to out. Returns
+    // false, with a message in *error, on a write error.
+    bool save_checkpoint(FILE *out, uint64_t trace_offset, const sim_stats_t *stats,
+                         std::string *error) const;
+    // Restore a checkpoint taken with the same configuration. If only the
+    // L1 configuration matches, just the L1 state is restored (L1 does not
+    // depend on L2), L2 stays cold and *stats is zeroed, which is enough to
+    // reuse a warmed L1 across L2 configurations. After a failed restore
+    // the simulator state is unspecified.
+    checkpoint_restore_t restore_checkpoint(FILE *in, uint64_t *trace_offset, sim_stats_t *stats,
+                                            std::string *error);
+
+    // Instrumentation (see instrument.hpp): miss classes so far, and heat
+    // maps written to prefix_l1_*.csv and prefix_l2_*.csv. Both return
+    // false, with a message in *error, when built without it. Counts
+    // include warming and cover only simulated sets under set sampling;
+    // checkpoints do not save them.
+    bool instrument_report(sim_instrument_stats_t *out, std::string *error) const;
+    bool instrument_dump(const std::string &prefix, std::string *error) const;
+
+private:
+    typedef void (CacheSimulator::*access_fn_t)(char rw, uint64_t addr, sim_stats_t *stats);
+    typedef void (CacheSimulator::*batch_fn_t)(const access_t *recs, size_t n, sim_stats_t *stats);
+    struct Kernel {
+        access_fn_t access;
+        batch_fn_t batch;
+    };
+
+    template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+    void access_kernel(char rw, uint64_t addr, sim_stats_t *stats);
+    template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+    void batch_kernel(const access_t *recs, size_t n, sim_stats_t *stats);
+    template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+    void l1_miss(char rw, uint64_t addr, uint64_t l1_index, uint64_t l1_tag, sim_stats_t *stats);
+    template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+    static Kernel make_kernel();
+    template <unsigned A1, unsigned A2>
+    static Kernel pick_kernel_pf(prefetch_algo_t pf);
+    template <unsigned A1>
+    static Kernel pick_kernel_l2(uint64_t a2, prefetch_algo_t pf, bool l2_enabled);
+    Kernel pick_kernel(bool specialize) const;
+
+    void touch_block_l1(uint64_t set, int way);
+    void touch_block_l2(uint64_t set, int way);
+    void insert_block_l1(uint64_t set, int way);
+    void insert_block_l2(uint64_t set, int way);
+    template <unsigned A>
+    static int pick_victim(const CacheArray &cache, uint64_t set);
+    uint64_t sample_rank(uint64_t block_addr) const;
+    void sampled_access(char rw, uint64_t addr, sim_stats_t *stats);
+    void sampled_batch(const access_t *recs, size_t n, sim_stats_t *stats);
+    void finish_sampled(sim_stats_t *stats) const;
+    template <unsigned A1>
+    bool is_in_l1(uint64_t block_addr) const;
+    template <unsigned A2>
+    bool is_in_l2(uint64_t block_addr) const;
+    template <unsigned A1, unsigned A2>
+    bool prefetch_install_l2(uint64_t pf_block_addr, sim_stats_t *stats);
+    uint64_t markov_home(uint64_t block_addr) const;
+    uint32_t markov_find(uint64_t block_addr) const;
+    void markov_index_insert(uint32_t row);
+    void markov_index_erase(uint32_t row);
+    void markov_lru_unlink(uint32_t row);
+    void markov_lru_push_front(uint32_t row);
+    void markov_touch_row(uint32_t row);
+    void markov_update(uint64_t current_block_addr);
+    bool markov_predict(uint64_t block_addr, uint64_t &predicted_addr) const;
+
+    sim_config_t config;
+    access_fn_t access_fn;
+    batch_fn_t batch_fn;
+
+    // Cache and Markov state; arena points at own_arena unless the caller
+    // passed one
+    Arena own_arena;
+    Arena *arena;
+
+    // Markov rows live in markov_rows[0, markov_rows_used) of the
+    // n_markov_rows allocated; markov_index is an open-addressing (linear
+    // probing) map of 2^markov_index_bits slots from block address to row
+    MarkovRow *markov_rows = nullptr;
+    uint32_t *markov_index = nullptr;
+    uint64_t markov_index_bits = 0;
+    uint32_t markov_rows_used = 0;
+    uint32_t markov_lru_head = MARKOV_NONE; // MRU row
+    uint32_t markov_lru_tail = MARKOV_NONE; // LRU row
+    uint64_t prev_block_addr = 0;
+    bool has_prev_block = false;
+    uint64_t n_markov_rows = 0;
+
+    CacheArray l1;
+    CacheArray l2;
+
+    uint64_t l1_b_bits;
+    uint64_t l1_sets;
+    uint64_t l1_idx_bits;
+    uint64_t l1_associativity;
+
+    uint64_t l2_b_bits;
+    uint64_t l2_sets;
+    uint64_t l2_idx_bits;
+    uint64_t l2_associativity;
+
+    replacement_policy_t l1_repl_policy;
+    replacement_policy_t l2_repl_policy;
+
+    // set sampling: units (runs of 2^sample_run_bits sets of the sampled
+    // level) ranked below sample_keep are simulated, with their counters
+    // spread over sample_buckets buckets for the error bars
+    bool sample_l1 = false;
+    bool sample_l2 = false;
+    uint64_t sample_unit_bits = 0;
+    uint64_t sample_run_bits = 0;
+    uint64_t sample_keep = 0;
+    unsigned sample_buckets = 0;
+    std::vector<sim_stats_t> sample_stats;
+    // inside warm(): sampled events go to the scratch counters instead
+    bool warming = false;
+
+    // time sampling: counters at the start of the open window, and the
+    // counters of each closed one
+    sim_stats_t window_start = sim_stats_t();
+    std::vector<sim_stats_t> window_stats;
+
+    uint64_t l2_mru_counter = 0;
+    uint64_t l2_lip_counter = 0;
+    uint64_t l1_timestamp = 0;
+
+#ifdef CACHESIM_INSTRUMENT
+    LevelInstrument l1_instrument;
+    LevelInstrument l2_instrument;
+#endif
+};
+
+#endif /* CACHE_SIMULATOR_HPP */
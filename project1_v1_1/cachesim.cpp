@@ -1,61 +1,59 @@
 #include "cachesim.hpp"
+#include "cache_simulator.hpp"
 #include <iostream>
 #include <vector>
 #include <cassert>
 #include <algorithm>
 #include <cstdlib>
-#include <unordered_map>
-#include <list>
-
-static sim_config_t global_config;
-
-struct CacheBlock {
-    uint64_t tag = 0;
-    bool valid = false;
-    bool dirty = false;
-    bool prefetched = false;
-    uint64_t last_used = 0;
-};
-
-// Markov Prefetcher State
-struct MarkovEntry {
-    uint64_t count;
-    uint64_t next_block_addr;
-};
-struct MarkovRow {
-    std::vector<MarkovEntry> entries;
-};
-static std::unordered_map<uint64_t, MarkovRow> markov_table;
-static std::list<uint64_t> markov_row_lru;
-static uint64_t prev_block_addr = 0;
-static bool has_prev_block = false;
-static uint64_t n_markov_entries = 0;
-static uint64_t n_markov_rows = 0;
-
-static std::vector<std::vector<CacheBlock>> l1_cache;
-static std::vector<std::vector<CacheBlock>> l2_cache;
-
-static uint64_t l1_b_bits;
-static uint64_t l1_sets;
-static uint64_t l1_idx_bits;
-static uint64_t l1_associativity;
-
-static uint64_t l2_b_bits;
-static uint64_t l2_sets;
-static uint64_t l2_idx_bits;
-static uint64_t l2_associativity;
-
-static replacement_policy_t l1_repl_policy;
-static replacement_policy_t l2_repl_policy;
-
-static uint64_t l2_mru_counter = 0;
-static uint64_t l2_lip_counter = 0;
-static uint64_t l1_timestamp = 0;
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <cmath>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-void sim_setup(sim_config_t *config) {
-    global_config = *config;
-    const cache_config_t& l1_cfg = global_config.l1_config;
-    const cache_config_t& l2_cfg = global_config.l2_config;
+bool CacheSimulator::check_config(const sim_config_t &config, std::string *error) {
+    const cache_config_t& l1_cfg = config.l1_config;
+    const cache_config_t& l2_cfg = config.l2_config;
+    uint64_t C1 = l1_cfg.c, B1 = l1_cfg.b, S1 = l1_cfg.s;
+    uint64_t C2 = l2_cfg.c, B2 = l2_cfg.b, S2 = l2_cfg.s;
+    std::ostringstream msg;
+
+    if (!(5 <= B1 && B1 <= 7)) {
+        msg << "Error: L1 b_bits must be in [5,7]. Got " << B1;
+    } else if (!(5 <= B2 && B2 <= 7)) {
+        msg << "Error: L2 b_bits must be in [5,7]. Got " << B2;
+    } else if (B1 + S1 > C1) {
+        msg << "Error: Require C1 >= B + S1. Got C1=" << C1 << " B=" << B1 << " S1=" << S1;
+    } else if (B2 + S2 > C2) {
+        msg << "Error: Require C2 >= B + S2. Got C2=" << C2 << " B=" << B2 << " S2=" << S2;
+    } else if (!l2_cfg.disabled && !(C2 > C1)) {
+        msg << "Error: Require C2 > C1. Got C1=" << C1 << " C2=" << C2;
+    } else if (!l2_cfg.disabled && !(S2 >= S1)) {
+        msg << "Error: Require S2 >= S1. Got S1=" << S1 << " S2=" << S2;
+    } else if ((l2_cfg.prefetch_algorithm == PREFETCH_MARKOV || l2_cfg.prefetch_algorithm == PREFETCH_HYBRID)) {
+        if (l2_cfg.n_markov_rows == 0) {
+            msg << "Error: Markov rows must be > 0 for Markov/Hybrid. Got " << l2_cfg.n_markov_rows;
+        } else if (l2_cfg.n_markov_rows > MARKOV_MAX_ROWS) {
+            msg << "Error: Markov rows must be <= " << MARKOV_MAX_ROWS << ". Got " << l2_cfg.n_markov_rows;
+        }
+    } else {
+        if (l2_cfg.n_markov_rows != 0) {
+            msg << "Invalid configuration! Number of Markov rows should be 0 if not using the Markov or Hybrid prefetching algorithms";
+        }
+    }
+
+    if (error) {
+        *error = msg.str();
+    }
+    return msg.str().empty();
+}
+
+CacheSimulator::CacheSimulator(const sim_config_t &sim_config, bool specialize, Arena *state_arena)
+    : config(sim_config), arena(state_arena ? state_arena : &own_arena) {
+    const cache_config_t& l1_cfg = config.l1_config;
+    const cache_config_t& l2_cfg = config.l2_config;
 
     uint64_t C1 = l1_cfg.c, B1 = l1_cfg.b, S1 = l1_cfg.s;
     uint64_t C2 = l2_cfg.c, B2 = l2_cfg.b, S2 = l2_cfg.s;
@@ -73,10 +71,16 @@ void sim_setup(sim_config_t *config) {
     l1_repl_policy = l1_cfg.replace_policy;
     l2_repl_policy = l2_cfg.replace_policy;
 
-    n_markov_entries = 4; // fixed at 4 entries per row
+    // the whole Markov table is allocated up front; the index keeps at
+    // most half its slots full
     n_markov_rows = l2_cfg.n_markov_rows;
-    markov_table.clear();
-    markov_row_lru.clear();
+    markov_index_bits = 1;
+    while ((1ULL << markov_index_bits) < 2 * n_markov_rows) {
+        markov_index_bits++;
+    }
+    markov_rows_used = 0;
+    markov_lru_head = MARKOV_NONE;
+    markov_lru_tail = MARKOV_NONE;
     has_prev_block = false;
     prev_block_addr = 0;
 
@@ -84,163 +88,320 @@ void sim_setup(sim_config_t *config) {
     l2_mru_counter = 0;
     l2_lip_counter = 0;
 
-    if (!(5 <= l1_b_bits && l1_b_bits <= 7)) {
-        std::cerr << "Error: L1 b_bits must be in [5,7]. Got " << l1_b_bits << "\n";
+    std::string error;
+    if (!check_config(config, &error)) {
+        std::cerr << error << "\n";
         std::exit(1);
     }
-    if (!(5 <= l2_b_bits && l2_b_bits <= 7)) {
-        std::cerr << "Error: L2 b_bits must be in [5,7]. Got " << l2_b_bits << "\n";
-        std::exit(1);
-    }
-    if (!l2_cfg.disabled && !(C2 > C1)) {
-        std::cerr << "Error: Require C2 > C1. Got C1=" << C1 << " C2=" << C2 << "\n";
-        std::exit(1);
+
+    // One arena for everything. Its memory comes back zeroed, which is
+    // already the initial state: all blocks invalid, clean and not
+    // prefetched, and rows are only read once markov_update() fills them.
+    uint64_t index_slots = 1ULL << markov_index_bits;
+    arena->reserve(arena_round(CacheArray::words_for(l1_sets, l1_associativity) * sizeof(uint64_t))
+                   + arena_round(CacheArray::words_for(l2_sets, l2_associativity) * sizeof(uint64_t))
+                   + arena_round(n_markov_rows * sizeof(MarkovRow)) + arena_round(index_slots * sizeof(uint32_t)));
+    l1.init(*arena, l1_sets, l1_associativity);
+    l2.init(*arena, l2_sets, l2_associativity);
+    markov_rows = arena->alloc_array<MarkovRow>(n_markov_rows);
+    markov_index = arena->alloc_array<uint32_t>(index_slots);
+    std::fill(markov_index, markov_index + index_slots, MARKOV_NONE);
+    INSTRUMENT(l1_instrument.init(l1_sets, l1_associativity));
+    INSTRUMENT(l2_instrument.init(l2_sets, l2_associativity));
+
+    Kernel kernel = pick_kernel(specialize);
+    access_fn = kernel.access;
+    batch_fn = kernel.batch;
+}
+
+// round every array up to whole 64-byte lines so each one starts aligned
+static uint64_t round_line(uint64_t words) {
+    return (words + 7) & ~(uint64_t)7;
+}
+
+uint64_t CacheArray::words_for(uint64_t n_sets, uint64_t n_ways) {
+    return 2 * round_line(n_sets * n_ways) + 3 * round_line(n_sets * ((n_ways + 63) / 64));
+}
+
+void CacheArray::init(Arena &arena, uint64_t n_sets, uint64_t n_ways) {
+    sets = n_sets;
+    ways = n_ways;
+    words = (n_ways + 63) / 64;
+    uint64_t blocks = round_line(sets * ways);
+    uint64_t masks = round_line(sets * words);
+    storage_words = words_for(sets, ways);
+    storage = arena.alloc_array<uint64_t>(storage_words);
+    tags = storage;
+    last_used = tags + blocks;
+    valid = last_used + blocks;
+    dirty = valid + masks;
+    prefetched = dirty + masks;
+}
+
+static inline bool get_bit(const uint64_t *masks, uint64_t words, uint64_t set, int way) {
+    return (masks[set * words + (way >> 6)] >> (way & 63)) & 1;
+}
+
+static inline void put_bit(uint64_t *masks, uint64_t words, uint64_t set, int way, bool value) {
+    uint64_t &word = masks[set * words + (way >> 6)];
+    uint64_t bit = 1ULL << (way & 63);
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+// Bit i set if tags[i] == tag, for the n <= 64 ways starting at tags. n is
+// always a power of two, so with AVX2 and n >= 4 the set's tags are
+// compared four at a time with aligned loads.
+static inline uint64_t match_tags(const uint64_t *tags, int n, uint64_t tag) {
+    uint64_t mask = 0;
+#ifdef __AVX2__
+    if (n >= 4) {
+        const __m256i needle = _mm256_set1_epi64x((long long)tag);
+        for (int i = 0; i < n; i += 4) {
+            __m256i eq = _mm256_cmpeq_epi64(_mm256_load_si256((const __m256i *)(tags + i)), needle);
+            mask |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(eq)) << i;
+        }
+        return mask;
     }
-    if (!l2_cfg.disabled && !(S2 >= S1)) {
-        std::cerr << "Error: Require S2 >= S1. Got S1=" << S1 << " S2=" << S2 << "\n";
-        std::exit(1);
+#endif
+    for (int i = 0; i < n; i++) {
+        mask |= (uint64_t)(tags[i] == tag) << i;
     }
-    if ((l2_cfg.prefetch_algorithm == PREFETCH_MARKOV || l2_cfg.prefetch_algorithm == PREFETCH_HYBRID)) {
-        if (l2_cfg.n_markov_rows == 0) {
-            std::cerr << "Error: Markov rows must be > 0 for Markov/Hybrid. Got " << l2_cfg.n_markov_rows << "\n";
-            std::exit(1);
-        }
-    } else {
-        if (l2_cfg.n_markov_rows != 0) {
-            std::cerr << "Invalid configuration! Number of Markov rows should be 0 if not using the Markov or Hybrid prefetching algorithms\n";
-            std::exit(1);
+    return mask;
+}
+
+// Way of `set` holding a valid block with `tag`, or -1.
+// A != 0 fixes the associativity at compile time; A == 0 uses cache.ways
+template <unsigned A>
+static inline int find_way(const CacheArray &cache, uint64_t set, uint64_t tag) {
+    const uint64_t ways = A ? A : cache.ways;
+    const uint64_t words = A ? (A + 63) / 64 : cache.words;
+    const uint64_t *tags = cache.tags + set * ways;
+    const uint64_t *valid = cache.valid + set * words;
+    for (uint64_t w = 0; w < words; w++) {
+        int n = ways - w * 64 < 64 ? (int)(ways - w * 64) : 64;
+        uint64_t hits = match_tags(tags + w * 64, n, tag) & valid[w];
+        if (hits) {
+            return (int)(w * 64) + __builtin_ctzll(hits);
         }
     }
+    return -1;
+}
 
-    l1_cache.assign(l1_sets, std::vector<CacheBlock>(l1_associativity));
-    l2_cache.assign(l2_sets, std::vector<CacheBlock>(l2_associativity));
-
-    for (uint64_t i = 0; i < l1_sets; i++)
-        for (uint64_t w = 0; w < l1_associativity; w++) {
-            l1_cache[i][w] = CacheBlock();
+// Way holding the smallest last_used of the n ways starting at last_used
+static inline int lru_way(const uint64_t *last_used, int n) {
+#ifdef __AVX2__
+    if (n >= 4) {
+        // stamps stay below 2^63, so signed compares order them correctly;
+        // strict compares keep the lowest way on ties, like the scalar scan
+        __m256i best = _mm256_load_si256((const __m256i *)last_used);
+        __m256i best_way = _mm256_set_epi64x(3, 2, 1, 0);
+        __m256i way = best_way;
+        const __m256i step = _mm256_set1_epi64x(4);
+        for (int i = 4; i < n; i += 4) {
+            way = _mm256_add_epi64(way, step);
+            __m256i v = _mm256_load_si256((const __m256i *)(last_used + i));
+            __m256i lt = _mm256_cmpgt_epi64(best, v);
+            best = _mm256_blendv_epi8(best, v, lt);
+            best_way = _mm256_blendv_epi8(best_way, way, lt);
         }
-    for (uint64_t i = 0; i < l2_sets; i++)
-        for (uint64_t w = 0; w < l2_associativity; w++) {
-            l2_cache[i][w] = CacheBlock();
+        alignas(32) uint64_t lane_best[4];
+        alignas(32) uint64_t lane_way[4];
+        _mm256_store_si256((__m256i *)lane_best, best);
+        _mm256_store_si256((__m256i *)lane_way, best_way);
+        int victim = (int)lane_way[0];
+        uint64_t smallest = lane_best[0];
+        for (int i = 1; i < 4; i++) {
+            if (lane_best[i] < smallest || (lane_best[i] == smallest && (int)lane_way[i] < victim)) {
+                victim = (int)lane_way[i];
+                smallest = lane_best[i];
+            }
+        }
+        return victim;
+    }
+#endif
+    int victim = 0;
+    uint64_t smallest = last_used[0];
+    for (int way = 1; way < n; way++) {
+        if (last_used[way] < smallest) {
+            victim = way;
+            smallest = last_used[way];
         }
+    }
+    return victim;
 }
 
 // promote block to MRU for L1
-static inline void touch_block_l1(CacheBlock &block) {
-    block.last_used = ++l1_timestamp;
+void CacheSimulator::touch_block_l1(uint64_t set, int way) {
+    l1.last_used[set * l1.ways + way] = ++l1_timestamp;
 }
 
 // promote block to MRU for L2
-static inline void touch_block_l2(CacheBlock &block) {
-    block.last_used = (1ULL << 32) + (++l2_mru_counter);
+void CacheSimulator::touch_block_l2(uint64_t set, int way) {
+    l2.last_used[set * l2.ways + way] = (1ULL << 32) + (++l2_mru_counter);
 }
 
 // insert with appropriate policy for L1 (always MIP)
-static inline void insert_block_l1(CacheBlock &block) {
-    block.last_used = ++l1_timestamp;
+void CacheSimulator::insert_block_l1(uint64_t set, int way) {
+    l1.last_used[set * l1.ways + way] = ++l1_timestamp;
 }
 
 // insert with appropriate policy for L2
-static inline void insert_block_l2(CacheBlock &block) {
+void CacheSimulator::insert_block_l2(uint64_t set, int way) {
     if (l2_repl_policy == REPLACEMENT_POLICY_MIP) {
-        block.last_used = (1ULL << 32) + (++l2_mru_counter);
+        l2.last_used[set * l2.ways + way] = (1ULL << 32) + (++l2_mru_counter);
     } else {
-        block.last_used = (1ULL << 32) - 1 - (l2_lip_counter++);
+        l2.last_used[set * l2.ways + way] = (1ULL << 32) - 1 - (l2_lip_counter++);
     }
 }
 
-// Pick victim
-    // prefer invalid blocks, then LRU (smallest last_used)
-static int pick_victim(std::vector<CacheBlock>& set) {
-    for (int way = 0; way < (int)set.size(); way++) {
-        if (!set[way].valid) {
-            return way;
+// Pick victim: prefer invalid blocks (first clear valid bit), then LRU
+// (smallest last_used)
+template <unsigned A>
+int CacheSimulator::pick_victim(const CacheArray &cache, uint64_t set) {
+    const uint64_t ways = A ? A : cache.ways;
+    const uint64_t words = A ? (A + 63) / 64 : cache.words;
+    const uint64_t *valid = cache.valid + set * words;
+    for (uint64_t w = 0; w < words; w++) {
+        uint64_t n = ways - w * 64;
+        uint64_t in_set = n < 64 ? (1ULL << n) - 1 : ~0ULL;
+        uint64_t invalid = ~valid[w] & in_set;
+        if (invalid) {
+            return (int)(w * 64) + __builtin_ctzll(invalid);
         }
     }
-    int victim = 0;
-    uint64_t smallest = set[0].last_used;
-    for (int way = 1; way < (int)set.size(); way++) {
-        if (set[way].last_used < smallest) {
-            victim = way;
-            smallest = set[way].last_used;
-        }
-    }
-    return victim;
+    return lru_way(cache.last_used + set * ways, (int)ways);
 }
 
 // Check if a block address is present in L1
-static bool is_in_l1(uint64_t block_addr) {
+template <unsigned A1>
+bool CacheSimulator::is_in_l1(uint64_t block_addr) const {
     uint64_t idx = block_addr & ((1ULL << l1_idx_bits) - 1);
     uint64_t tag = block_addr >> l1_idx_bits;
-    auto &s = l1_cache[idx];
-    for (int w = 0; w < (int)l1_associativity; w++) {
-        if (s[w].valid == true && s[w].tag == tag)  {
-            return true;
-        }
-    }
-    return false;
+    return find_way<A1>(l1, idx, tag) >= 0;
 }
 
 // check if a block address is present in L2
-static bool is_in_l2(uint64_t block_addr) {
+template <unsigned A2>
+bool CacheSimulator::is_in_l2(uint64_t block_addr) const {
     uint64_t idx = block_addr & ((1ULL << l2_idx_bits) - 1);
     uint64_t tag = block_addr >> l2_idx_bits;
-    auto &s = l2_cache[idx];
-    for (int w = 0; w < (int)l2_associativity; w++) {
-        if (s[w].valid == true && s[w].tag == tag) {
-            return true;
-        }
-    }
-    return false;
+    return find_way<A2>(l2, idx, tag) >= 0;
 }
 
 // install a prefetched block into L2. return true if actually inserted.
-static bool prefetch_install_l2(uint64_t pf_block_addr, sim_stats_t *stats) {
+template <unsigned A1, unsigned A2>
+bool CacheSimulator::prefetch_install_l2(uint64_t pf_block_addr, sim_stats_t *stats) {
+    // Under set sampling, unsampled sets are never simulated
+    if (sample_l2 && sample_rank(pf_block_addr) >= sample_keep) {
+        return false;
+    }
     // Check if already in L1 or L2
-    if (is_in_l1(pf_block_addr) || is_in_l2(pf_block_addr)) {
+    if (is_in_l1<A1>(pf_block_addr) || is_in_l2<A2>(pf_block_addr)) {
         return false;
     }
 
     uint64_t pf_idx = pf_block_addr & ((1ULL << l2_idx_bits) - 1);
     uint64_t pf_tag = pf_block_addr >> l2_idx_bits;
 
-    auto &pf_set = l2_cache[pf_idx];
-    int v = pick_victim(pf_set);
-    CacheBlock &victim = pf_set[v];
+    int v = pick_victim<A2>(l2, pf_idx);
+    INSTRUMENT(if (get_bit(l2.valid, l2.words, pf_idx, v)) l2_instrument.evict(pf_idx));
+    INSTRUMENT(l2_instrument.fill(pf_block_addr));
 
     // If evicting a prefetched block, count prefetch miss
-    if (victim.valid == true && victim.prefetched == true) {
+    if (get_bit(l2.valid, l2.words, pf_idx, v) && get_bit(l2.prefetched, l2.words, pf_idx, v)) {
         stats->prefetch_misses_l2++;
     }
 
-    victim.valid = true;
-    victim.dirty = false;
-    victim.tag = pf_tag;
-    victim.prefetched = true;
-    insert_block_l2(victim);
+    put_bit(l2.valid, l2.words, pf_idx, v, true);
+    put_bit(l2.dirty, l2.words, pf_idx, v, false);
+    l2.tags[pf_idx * l2.ways + v] = pf_tag;
+    put_bit(l2.prefetched, l2.words, pf_idx, v, true);
+    insert_block_l2(pf_idx, v);
 
     stats->prefetches_issued_l2++;
     return true;
 }
 
-static void markov_touch_row(uint64_t block_addr) {
-    // remove block_addr from wherever it currently is in the LRU list (if present)
-    bool removed = false;
-    // walk through the list and look for block_addr
-    for (auto it = markov_row_lru.begin(); it != markov_row_lru.end(); ++it) {
-        if (*it == block_addr) {
-            // erase removes this element from the list
-            markov_row_lru.erase(it);
-            removed = true;
-            break;
+// Slot in markov_index for block_addr (Fibonacci hashing)
+uint64_t CacheSimulator::markov_home(uint64_t block_addr) const {
+    return (block_addr * 0x9E3779B97F4A7C15ULL) >> (64 - markov_index_bits);
+}
+
+// Row index holding block_addr, or MARKOV_NONE
+uint32_t CacheSimulator::markov_find(uint64_t block_addr) const {
+    uint64_t mask = (1ULL << markov_index_bits) - 1;
+    for (uint64_t slot = markov_home(block_addr);; slot = (slot + 1) & mask) {
+        uint32_t row = markov_index[slot];
+        if (row == MARKOV_NONE || markov_rows[row].block_addr == block_addr) {
+            return row;
         }
     }
-    // insert block_addr at the front so it becomes MRU
-    markov_row_lru.push_front(block_addr);
+}
+
+void CacheSimulator::markov_index_insert(uint32_t row) {
+    uint64_t mask = (1ULL << markov_index_bits) - 1;
+    uint64_t slot = markov_home(markov_rows[row].block_addr);
+    while (markov_index[slot] != MARKOV_NONE) {
+        slot = (slot + 1) & mask;
+    }
+    markov_index[slot] = row;
+}
+
+// Remove row's slot, shifting later members of its probe run back so
+// lookups never need tombstones
+void CacheSimulator::markov_index_erase(uint32_t row) {
+    uint64_t mask = (1ULL << markov_index_bits) - 1;
+    uint64_t hole = markov_home(markov_rows[row].block_addr);
+    while (markov_index[hole] != row) {
+        hole = (hole + 1) & mask;
+    }
+    for (uint64_t slot = (hole + 1) & mask; markov_index[slot] != MARKOV_NONE; slot = (slot + 1) & mask) {
+        uint64_t home = markov_home(markov_rows[markov_index[slot]].block_addr);
+        // move the entry if the hole lies between its home slot and its slot
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            markov_index[hole] = markov_index[slot];
+            hole = slot;
+        }
+    }
+    markov_index[hole] = MARKOV_NONE;
+}
+
+void CacheSimulator::markov_lru_unlink(uint32_t row) {
+    MarkovRow &r = markov_rows[row];
+    if (r.prev != MARKOV_NONE) {
+        markov_rows[r.prev].next = r.next;
+    } else {
+        markov_lru_head = r.next;
+    }
+    if (r.next != MARKOV_NONE) {
+        markov_rows[r.next].prev = r.prev;
+    } else {
+        markov_lru_tail = r.prev;
+    }
+}
+
+void CacheSimulator::markov_lru_push_front(uint32_t row) {
+    MarkovRow &r = markov_rows[row];
+    r.prev = MARKOV_NONE;
+    r.next = markov_lru_head;
+    if (markov_lru_head != MARKOV_NONE) {
+        markov_rows[markov_lru_head].prev = row;
+    } else {
+        markov_lru_tail = row;
+    }
+    markov_lru_head = row;
+}
+
+// Move a row to the MRU end of the row LRU list
+void CacheSimulator::markov_touch_row(uint32_t row) {
+    if (row != markov_lru_head) {
+        markov_lru_unlink(row);
+        markov_lru_push_front(row);
+    }
 }
 
 // This function updates the markov table with prev_block -> current_block
-static void markov_update(uint64_t current_block_addr) {
+void CacheSimulator::markov_update(uint64_t current_block_addr) {
     // If this is first block there is no transition yet
     // initial it as the previous block
     if (!has_prev_block) {
@@ -254,16 +415,16 @@ static void markov_update(uint64_t current_block_addr) {
     uint64_t B = current_block_addr;
 
     // Check if the Markov Row for A already exists
-    auto row_it = markov_table.find(A);
-    if (row_it != markov_table.end()) {
+    uint32_t row_idx = markov_find(A);
+    if (row_idx != MARKOV_NONE) {
         // Row A exists
-        MarkovRow &row = row_it->second;
+        MarkovRow &row = markov_rows[row_idx];
         bool found = false;
         // Look for an exisitng entry in row A that points to B
-        for (auto &entry : row.entries) {
+        for (uint32_t i = 0; i < row.n_entries; i++) {
             // Found: then increment the count
-            if (entry.next_block_addr == B) {
-                entry.count++;
+            if (row.entries[i].next_block_addr == B) {
+                row.entries[i].count++;
                 found = true;
                 break;
             }
@@ -271,15 +432,12 @@ static void markov_update(uint64_t current_block_addr) {
         // If not found, then we add it or evict if its full
         if (!found) {
             // Still have enough room
-            if (row.entries.size() < n_markov_entries) {
-                row.entries.push_back({1, B});
+            if (row.n_entries < MARKOV_ENTRIES) {
+                row.entries[row.n_entries++] = {1, B};
             } else {
-            // Otherwise, Row is full, evict one entry to mkae space
-            // Use LFU (evict smallest)
-            // Tie break: evicit the one with lower successor block address
                 // Row is full: evict LFU entry; tie-break: evict the one with LOWER successor block address
-                auto min_it = row.entries.begin(); 
-                for (auto it = row.entries.begin(); it != row.entries.end(); ++it) {
+                MarkovEntry *min_it = &row.entries[0];
+                for (MarkovEntry *it = row.entries; it != row.entries + MARKOV_ENTRIES; ++it) {
                     // Pick the smaller count (LFU)
                     if (it->count < min_it->count) {
                         min_it = it;
@@ -294,45 +452,46 @@ static void markov_update(uint64_t current_block_addr) {
             }
         }
         // Mark row A as MRU
-        markov_touch_row(A);
+        markov_touch_row(row_idx);
     } else {
-        // Row A doesn't exist then insert new row
-        if (markov_table.size() >= n_markov_rows) {
-            // Evict LRU row
-            uint64_t lru_key = markov_row_lru.back();
-            markov_row_lru.pop_back();
-            markov_table.erase(lru_key);
+        // Row A doesn't exist then insert new row, reusing the LRU row's
+        // storage once the table is full
+        if (markov_rows_used >= n_markov_rows) {
+            row_idx = markov_lru_tail;
+            markov_index_erase(row_idx);
+            markov_lru_unlink(row_idx);
+        } else {
+            row_idx = markov_rows_used++;
         }
-        MarkovRow new_row;
-        new_row.entries.push_back({1, B});
-        markov_table[A] = new_row;
-        markov_row_lru.push_front(A);
+        MarkovRow &row = markov_rows[row_idx];
+        row.block_addr = A;
+        row.entries[0] = {1, B};
+        row.n_entries = 1;
+        markov_index_insert(row_idx);
+        markov_lru_push_front(row_idx);
     }
 
     prev_block_addr = current_block_addr;
-    if (markov_table.find(current_block_addr) != markov_table.end()) {
-        markov_touch_row(current_block_addr);
+    uint32_t current_row = markov_find(current_block_addr);
+    if (current_row != MARKOV_NONE) {
+        markov_touch_row(current_row);
     }
 }
 // Find best successor of block_addr, called A
 // Returns true and sets predicted_addr if a prediction exists
-static bool markov_predict(uint64_t block_addr, uint64_t &predicted_addr) {
+bool CacheSimulator::markov_predict(uint64_t block_addr, uint64_t &predicted_addr) const {
     // Look up Markov Row for A
-    auto row_it = markov_table.find(block_addr); 
+    uint32_t row_idx = markov_find(block_addr);
 
     // If we have not seen this block, there is no prediction
-    if (row_it == markov_table.end()) {
-        return false;
-    }
-    // Get reference to the row (List of candidate succesors + observed counts)
-        // If the row is empty, there is no succesor -> Return False
-    MarkovRow &row = row_it->second;
-    if (row.entries.empty()) {
+    // (rows are created with one entry, so a row always has a successor)
+    if (row_idx == MARKOV_NONE) {
         return false;
     }
+    const MarkovRow &row = markov_rows[row_idx];
     // Choose the best succesor:
-    auto best_it = row.entries.begin();
-    for (auto it = row.entries.begin(); it != row.entries.end(); ++it) {
+    const MarkovEntry *best_it = &row.entries[0];
+    for (const MarkovEntry *it = row.entries; it != row.entries + row.n_entries; ++it) {
         // higher count is preferred
         if (it->count > best_it->count) {
             best_it = it;
@@ -346,15 +505,13 @@ static bool markov_predict(uint64_t block_addr, uint64_t &predicted_addr) {
     return true;
 }
 
-void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
+// The whole access path, specialized on L1/L2 associativity (0 = runtime
+// value), prefetcher and whether L2 exists. With those fixed, the way loops
+// unroll and the untaken prefetcher/L2 branches compile away.
+template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+void CacheSimulator::access_kernel(char rw, uint64_t addr, sim_stats_t* stats) {
     uint64_t l1_index = (addr >> l1_b_bits) & ((1ULL << l1_idx_bits) - 1);
     uint64_t l1_tag = addr >> (l1_b_bits + l1_idx_bits);
-    uint64_t l2_index = (addr >> l2_b_bits) & ((1ULL << l2_idx_bits) - 1);
-    uint64_t l2_tag = addr >> (l2_b_bits + l2_idx_bits);
-    uint64_t block_addr = addr >> l2_b_bits;
-
-    const cache_config_t& l2_cfg = global_config.l2_config;
-    bool l2_disabled = l2_cfg.disabled;
 
     stats->accesses_l1++;
     if (rw == 'R') {
@@ -364,92 +521,170 @@ void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
     }
 
     // L1 Lookup
-    auto &l1_set = l1_cache[l1_index];
-    int l1_hit_way = -1;
-    for (int way = 0; way < (int)l1_associativity; way++) {
-        CacheBlock &blk = l1_set[way];
-        if (blk.valid && blk.tag == l1_tag) {
-            l1_hit_way = way;
-            break;
-        }
-    }
+    int l1_hit_way = find_way<A1>(l1, l1_index, l1_tag);
+    INSTRUMENT(l1_instrument.access(l1_index, l1_hit_way, addr >> l1_b_bits));
 
     if (l1_hit_way != -1) { // found a hit thus L1 Hit
         stats->hits_l1++;
-        CacheBlock &hit_blk = l1_set[l1_hit_way];
         if (rw == 'W') {
-            hit_blk.dirty = true;
+            put_bit(l1.dirty, l1.words, l1_index, l1_hit_way, true);
         }
-        touch_block_l1(hit_blk);
+        touch_block_l1(l1_index, l1_hit_way);
         return;
     }
 
+    l1_miss<A1, A2, PF, L2>(rw, addr, l1_index, l1_tag, stats);
+}
+
+// Accesses handled per round of index/tag precomputation in batch_kernel
+static const size_t BATCH_CHUNK = 64;
+// How many accesses ahead batch_kernel prefetches L1 sets
+static const size_t BATCH_PREFETCH_AHEAD = 8;
+
+// The access path over an array of packed accesses. The reads/writes/L1
+// hit counters live in locals for the whole batch, and each chunk's L1
+// indices and tags are computed in one pass so the sets a few accesses
+// ahead can be prefetched while the current one is simulated.
+template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+void CacheSimulator::batch_kernel(const access_t *recs, size_t n, sim_stats_t *stats) {
+    const uint64_t idx_mask = (1ULL << l1_idx_bits) - 1;
+    const uint64_t b_bits = l1_b_bits;
+    const uint64_t tag_shift = l1_b_bits + l1_idx_bits;
+    const uint64_t ways = A1 ? A1 : l1.ways;
+    uint64_t writes = 0;
+    uint64_t hits = 0;
+    uint64_t index[BATCH_CHUNK];
+    uint64_t tag[BATCH_CHUNK];
+
+    for (size_t base = 0; base < n; base += BATCH_CHUNK) {
+        const access_t *chunk = recs + base;
+        size_t m = n - base < BATCH_CHUNK ? n - base : BATCH_CHUNK;
+        for (size_t i = 0; i < m; i++) {
+            uint64_t addr = chunk[i] & ACCESS_ADDR_MASK;
+            index[i] = (addr >> b_bits) & idx_mask;
+            tag[i] = addr >> tag_shift;
+        }
+        for (size_t i = 0; i < m && i < BATCH_PREFETCH_AHEAD; i++) {
+            __builtin_prefetch(l1.tags + index[i] * ways);
+            __builtin_prefetch(l1.last_used + index[i] * ways);
+        }
+
+        for (size_t i = 0; i < m; i++) {
+            if (i + BATCH_PREFETCH_AHEAD < m) {
+                uint64_t ahead = index[i + BATCH_PREFETCH_AHEAD];
+                __builtin_prefetch(l1.tags + ahead * ways);
+                __builtin_prefetch(l1.last_used + ahead * ways);
+            }
+            bool is_write = (chunk[i] & ACCESS_WRITE_BIT) != 0;
+            writes += is_write;
+
+            int way = find_way<A1>(l1, index[i], tag[i]);
+            INSTRUMENT(l1_instrument.access(index[i], way, (chunk[i] & ACCESS_ADDR_MASK) >> b_bits));
+            if (way != -1) {
+                hits++;
+                if (is_write) {
+                    put_bit(l1.dirty, l1.words, index[i], way, true);
+                }
+                touch_block_l1(index[i], way);
+            } else {
+                l1_miss<A1, A2, PF, L2>(is_write ? WRITE : READ, chunk[i] & ACCESS_ADDR_MASK,
+                                        index[i], tag[i], stats);
+            }
+        }
+    }
+
+    stats->accesses_l1 += n;
+    stats->reads += n - writes;
+    stats->writes += writes;
+    stats->hits_l1 += hits;
+}
+
+// Everything after an L1 miss: the L2 read, prefetching, the L1 install
+// and the write-back of the L1 victim
+template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+void CacheSimulator::l1_miss(char rw, uint64_t addr, uint64_t l1_index, uint64_t l1_tag, sim_stats_t *stats) {
+    uint64_t l2_index = (addr >> l2_b_bits) & ((1ULL << l2_idx_bits) - 1);
+    uint64_t l2_tag = addr >> (l2_b_bits + l2_idx_bits);
+    uint64_t block_addr = addr >> l2_b_bits;
+
+    const bool l2_disabled = !L2;
+
     // L1 Miss
     stats->misses_l1++;
-    int l1_victim_w = pick_victim(l1_set);
-    CacheBlock &l1_victim = l1_set[l1_victim_w];
+    int l1_victim_w = pick_victim<A1>(l1, l1_index);
 
     // save L1 victim info before overwriting
-    bool victim_valid = l1_victim.valid;
-    bool victim_dirty = l1_victim.dirty;
-    uint64_t victim_tag = l1_victim.tag;
+    bool victim_valid = get_bit(l1.valid, l1.words, l1_index, l1_victim_w);
+    bool victim_dirty = get_bit(l1.dirty, l1.words, l1_index, l1_victim_w);
+    uint64_t victim_tag = l1.tags[l1_index * l1.ways + l1_victim_w];
+    INSTRUMENT(if (victim_valid) l1_instrument.evict(l1_index));
+
+    // Under L2 set sampling, blocks in unsampled L2 sets skip L2 entirely
+    // and sampled ones charge their L2 events to their set's bucket
+    sim_stats_t *l2_stats = stats;
+    bool l2_skip = false;
+    if (L2 && sample_l2) {
+        uint64_t rank = sample_rank(block_addr);
+        l2_skip = rank >= sample_keep;
+        if (!warming) {
+            l2_stats = &sample_stats[rank % sample_buckets];
+        }
+    }
 
     // 1) Read from L2 on L1 Cache Miss
     stats->reads_l2++;
     bool l2_read_hit = false;
 
-    if (!l2_disabled) { // If its not disabled where L2 is enabled do L2 Lookup
-        auto &l2_set = l2_cache[l2_index];
-        for (int way = 0; way < (int)l2_associativity; way++) {
-            CacheBlock &blk = l2_set[way];
-            if (blk.valid && blk.tag == l2_tag) {
-                l2_read_hit = true;
-                // Check prefetch bit
-                if (blk.prefetched) {
-                    stats->prefetch_hits_l2++;
-                    blk.prefetched = false;
-                }
-                touch_block_l2(blk);
-                break;
+    if (!l2_disabled && !l2_skip) { // If its not disabled where L2 is enabled do L2 Lookup
+        int way = find_way<A2>(l2, l2_index, l2_tag);
+        INSTRUMENT(l2_instrument.access(l2_index, way, block_addr));
+        if (way != -1) {
+            l2_read_hit = true;
+            // Check prefetch bit
+            if (get_bit(l2.prefetched, l2.words, l2_index, way)) {
+                l2_stats->prefetch_hits_l2++;
+                put_bit(l2.prefetched, l2.words, l2_index, way, false);
             }
+            touch_block_l2(l2_index, way);
         }
 
         if (l2_read_hit) {
-            stats->read_hits_l2++;
+            l2_stats->read_hits_l2++;
         } else {
             // L2 read miss then install requested block in L2
-            stats->read_misses_l2++;
-            int l2_victim_w = pick_victim(l2_set);
-            CacheBlock &l2_v = l2_set[l2_victim_w];
+            l2_stats->read_misses_l2++;
+            int l2_victim_w = pick_victim<A2>(l2, l2_index);
+            INSTRUMENT(if (get_bit(l2.valid, l2.words, l2_index, l2_victim_w)) l2_instrument.evict(l2_index));
             // track the prefetch miss on eviction
-            if (l2_v.valid == true && l2_v.prefetched == true) {
-                stats->prefetch_misses_l2++;
+            if (get_bit(l2.valid, l2.words, l2_index, l2_victim_w)
+                && get_bit(l2.prefetched, l2.words, l2_index, l2_victim_w)) {
+                l2_stats->prefetch_misses_l2++;
             }
-            l2_v.valid = true;
-            l2_v.dirty = false;
-            l2_v.tag = l2_tag;
-            l2_v.prefetched = false;
-            insert_block_l2(l2_v);
+            put_bit(l2.valid, l2.words, l2_index, l2_victim_w, true);
+            put_bit(l2.dirty, l2.words, l2_index, l2_victim_w, false);
+            l2.tags[l2_index * l2.ways + l2_victim_w] = l2_tag;
+            put_bit(l2.prefetched, l2.words, l2_index, l2_victim_w, false);
+            insert_block_l2(l2_index, l2_victim_w);
         }
-    } else {
+    } else if (l2_disabled) {
         // L2 disabled then every read is a L2 miss
         stats->read_misses_l2++;
     }
 
     // Prefetch Logic ON a READ MISS before L1 install + WB
-    if (!l2_disabled && !l2_read_hit) {
-        prefetch_algo_t pf_algo = l2_cfg.prefetch_algorithm;
+    if (!l2_disabled && !l2_skip && !l2_read_hit) {
+        const prefetch_algo_t pf_algo = PF;
 
         if (pf_algo == PREFETCH_PLUS_ONE) {
             // +1 prefetcher then prefetch block_addr + 1
-            prefetch_install_l2(block_addr + 1, stats);
+            prefetch_install_l2<A1, A2>(block_addr + 1, l2_stats);
         }
         else if (pf_algo == PREFETCH_MARKOV) {
             // 1) predict and prefetch
             uint64_t predicted;
             if (markov_predict(block_addr, predicted)) {
                 if (predicted != block_addr) {
-                    prefetch_install_l2(predicted, stats);
+                    prefetch_install_l2<A1, A2>(predicted, l2_stats);
                 }
             }
             // 2) update Markov table
@@ -457,18 +692,17 @@ void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
         }
         else if (pf_algo == PREFETCH_HYBRID) {
             // check Markov table for entry 
-            auto row_it = markov_table.find(block_addr);
-            if (row_it != markov_table.end() && !row_it->second.entries.empty()) {
+            if (markov_find(block_addr) != MARKOV_NONE) {
                 // Row entry found: prefetch as predicted by Markov
                 uint64_t predicted;
                 if (markov_predict(block_addr, predicted)) {
                     if (predicted != block_addr) {
-                        prefetch_install_l2(predicted, stats);
+                        prefetch_install_l2<A1, A2>(predicted, l2_stats);
                     }
                 }
             } else {
                 // No row entry then fall back to +1
-                prefetch_install_l2(block_addr + 1, stats);
+                prefetch_install_l2<A1, A2>(block_addr + 1, l2_stats);
             }
             // Update Markov table
             markov_update(block_addr);
@@ -476,49 +710,102 @@ void sim_access(char rw, uint64_t addr, sim_stats_t* stats) {
     }
 
     // Install block in L1 (after prefetch, before writeback)
-    l1_victim.valid = true;
-    if (rw == 'W') {
-        l1_victim.dirty = true;
-    } else {
-        l1_victim.dirty = false;
-    }
-    l1_victim.tag = l1_tag;
-    l1_victim.prefetched = false;
-    insert_block_l1(l1_victim);
+    put_bit(l1.valid, l1.words, l1_index, l1_victim_w, true);
+    put_bit(l1.dirty, l1.words, l1_index, l1_victim_w, rw == 'W');
+    l1.tags[l1_index * l1.ways + l1_victim_w] = l1_tag;
+    put_bit(l1.prefetched, l1.words, l1_index, l1_victim_w, false);
+    insert_block_l1(l1_index, l1_victim_w);
 
     // evict and rriteback to L2 
     if (victim_valid == true && victim_dirty == true) {
         stats->write_backs_l1++;
         stats->writes_l2++;
 
-        if (!l2_disabled) {
-            // Reconstruct victim address and find in L2
-            uint64_t v_addr = (victim_tag << (l1_b_bits + l1_idx_bits)) | (l1_index << l1_b_bits);
+        // Reconstruct victim address and find in L2
+        uint64_t v_addr = (victim_tag << (l1_b_bits + l1_idx_bits)) | (l1_index << l1_b_bits);
+        if (!l2_disabled && !(sample_l2 && sample_rank(v_addr >> l2_b_bits) >= sample_keep)) {
             uint64_t v_l2_idx = (v_addr >> l2_b_bits) & ((1ULL << l2_idx_bits) - 1);
             uint64_t v_l2_tag = v_addr >> (l2_b_bits + l2_idx_bits);
 
-            auto &v_l2_set = l2_cache[v_l2_idx];
-            for (int way = 0; way < (int)l2_associativity; way++) {
-                CacheBlock &blk = v_l2_set[way];
-                if (blk.valid && blk.tag == v_l2_tag) {
-                    // WTWNA block present in L2, move to MRU
-                    touch_block_l2(blk);
-                    break;
-                }
+            int way = find_way<A2>(l2, v_l2_idx, v_l2_tag);
+            INSTRUMENT(l2_instrument.write(v_l2_idx, way, v_addr >> l2_b_bits));
+            if (way != -1) {
+                // WTWNA block present in L2, move to MRU
+                touch_block_l2(v_l2_idx, way);
             }
             // If not found in L2, then WTWNA don't install
         }
     }
 }
 
-void sim_finish(sim_stats_t *stats) {
+// Kernel selection. Associativities 1-16 (L1) and 1-32 (L2), the ranges the
+// sweeps use, get their own instantiations; anything else falls back to the
+// runtime-associativity kernel for that cache.
+template <unsigned A1, unsigned A2, prefetch_algo_t PF, bool L2>
+CacheSimulator::Kernel CacheSimulator::make_kernel() {
+    Kernel kernel;
+    kernel.access = &CacheSimulator::access_kernel<A1, A2, PF, L2>;
+    kernel.batch = &CacheSimulator::batch_kernel<A1, A2, PF, L2>;
+    return kernel;
+}
+
+template <unsigned A1, unsigned A2>
+CacheSimulator::Kernel CacheSimulator::pick_kernel_pf(prefetch_algo_t pf) {
+    switch (pf) {
+        case PREFETCH_PLUS_ONE: return make_kernel<A1, A2, PREFETCH_PLUS_ONE, true>();
+        case PREFETCH_MARKOV: return make_kernel<A1, A2, PREFETCH_MARKOV, true>();
+        case PREFETCH_HYBRID: return make_kernel<A1, A2, PREFETCH_HYBRID, true>();
+        default: return make_kernel<A1, A2, PREFETCH_NONE, true>();
+    }
+}
+
+template <unsigned A1>
+CacheSimulator::Kernel CacheSimulator::pick_kernel_l2(uint64_t a2, prefetch_algo_t pf, bool l2_enabled) {
+    if (!l2_enabled) {
+        return make_kernel<A1, 0, PREFETCH_NONE, false>();
+    }
+    switch (a2) {
+        case 1: return pick_kernel_pf<A1, 1>(pf);
+        case 2: return pick_kernel_pf<A1, 2>(pf);
+        case 4: return pick_kernel_pf<A1, 4>(pf);
+        case 8: return pick_kernel_pf<A1, 8>(pf);
+        case 16: return pick_kernel_pf<A1, 16>(pf);
+        case 32: return pick_kernel_pf<A1, 32>(pf);
+        default: return pick_kernel_pf<A1, 0>(pf);
+    }
+}
+
+CacheSimulator::Kernel CacheSimulator::pick_kernel(bool specialize) const {
+    prefetch_algo_t pf = config.l2_config.prefetch_algorithm;
+    bool l2_enabled = !config.l2_config.disabled;
+    if (!specialize) {
+        return l2_enabled ? pick_kernel_l2<0>(0, pf, true) : pick_kernel_l2<0>(0, pf, false);
+    }
+    switch (l1_associativity) {
+        case 1: return pick_kernel_l2<1>(l2_associativity, pf, l2_enabled);
+        case 2: return pick_kernel_l2<2>(l2_associativity, pf, l2_enabled);
+        case 4: return pick_kernel_l2<4>(l2_associativity, pf, l2_enabled);
+        case 8: return pick_kernel_l2<8>(l2_associativity, pf, l2_enabled);
+        case 16: return pick_kernel_l2<16>(l2_associativity, pf, l2_enabled);
+        default: return pick_kernel_l2<0>(l2_associativity, pf, l2_enabled);
+    }
+}
+
+void CacheSimulator::finish(sim_stats_t *stats) const {
+    if (sample_l1 || sample_l2) {
+        finish_sampled(stats);
+    }
+    finish_stats(config, stats);
+}
+
+void CacheSimulator::finish_stats(const sim_config_t &config, sim_stats_t *stats) {
     const double accesses_l1 = (double)stats->accesses_l1;
     const double hits_l1 = (double)stats->hits_l1;
     const double misses_l1 = (double)stats->misses_l1;
     const double reads_l2 = (double)stats->reads_l2;
     const double read_hits_l2 = (double)stats->read_hits_l2;
     const double read_misses_l2 = (double)stats->read_misses_l2;
-    const cache_config_t& l2_cfg = global_config.l2_config;
+    const cache_config_t& l2_cfg = config.l2_config;
     // L1 ratios
     if (accesses_l1 > 0.0) {
         stats->hit_ratio_l1 = hits_l1 / accesses_l1;
@@ -530,7 +817,7 @@ void sim_finish(sim_stats_t *stats) {
 
     // L1 hit time
     uint64_t S1 = 0;
-    uint64_t tmp1 = l1_associativity;
+    uint64_t tmp1 = 1ULL << config.l1_config.s;
     while (tmp1 > 1) { 
         tmp1 >>= 1; 
         S1++; 
@@ -538,7 +825,7 @@ void sim_finish(sim_stats_t *stats) {
     double l1_ht = L1_HIT_TIME_CONST + L1_HIT_TIME_PER_S * S1;
 
     // DRAM time
-    uint64_t block_size = 1ULL << l1_b_bits;
+    uint64_t block_size = 1ULL << config.l1_config.b;
     double dram_time = DRAM_AT + ((double)block_size / WORD_SIZE) * DRAM_AT_PER_WORD;
 
 
@@ -562,7 +849,7 @@ void sim_finish(sim_stats_t *stats) {
         }
         // L2 hit time
         uint64_t S2 = 0;
-        uint64_t tmp2 = l2_associativity;
+        uint64_t tmp2 = 1ULL << config.l2_config.s;
         while (tmp2 > 1) { 
             tmp2 >>= 1; 
             S2++; 
@@ -576,3 +863,606 @@ void sim_finish(sim_stats_t *stats) {
     // L1 AAT = HT_L1 + MR_L1 * L2_AAT
     stats->avg_access_time_l1 = l1_ht + stats->miss_ratio_l1 * stats->avg_access_time_l2;
 }
+
+static void pack_cache_config(const cache_config_t &c, uint64_t *out) {
+    out[0] = c.disabled;
+    out[1] = c.c;
+    out[2] = c.b;
+    out[3] = c.s;
+    out[4] = c.replace_policy;
+    out[5] = c.write_strat;
+    out[6] = c.prefetch_algorithm;
+    out[7] = c.n_markov_rows;
+}
+
+void CacheSimulator::pack_config(const sim_config_t &config, uint64_t *out) {
+    pack_cache_config(config.l1_config, out);
+    pack_cache_config(config.l2_config, out + SIM_CONFIG_WORDS / 2);
+}
+
+/* Set sampling */
+
+// Position of a sampling unit in a fixed pseudo-random order: a bijection
+// on bits-bit values (odd multiplies and xor-shifts), so exactly
+// sample_keep units rank below sample_keep
+static inline uint64_t unit_rank(uint64_t unit, uint64_t bits) {
+    const uint64_t mask = (bits == 64) ? ~0ULL : (1ULL << bits) - 1;
+    uint64_t h = (unit * 0x9E3779B97F4A7C15ULL) & mask;
+    h ^= h >> (bits / 2 + 1);
+    h = (h * 0xBF58476D1CE4E5B9ULL) & mask;
+    return h;
+}
+
+void CacheSimulator::sample_sets(uint64_t one_in) {
+    // With L2 enabled, L1 is simulated in full (its behaviour does not
+    // depend on L2) and only L2 sets are sampled; that is where large
+    // configurations spend their time. Without L2, L1 sets are sampled.
+    // Units are runs of consecutive sets, so +1 prefetches rarely leave the
+    // sample, and there are just enough of them to fill every bucket.
+    uint64_t set_bits = config.l2_config.disabled ? l1_idx_bits : l2_idx_bits;
+    uint64_t want_bits = 0;
+    while (want_bits < 63 && (1ULL << want_bits) < std::max<uint64_t>(one_in, 1) * SAMPLE_MAX_BUCKETS) {
+        want_bits++;
+    }
+    sample_unit_bits = std::min(set_bits, want_bits);
+    sample_run_bits = set_bits - sample_unit_bits;
+    uint64_t units = 1ULL << sample_unit_bits;
+    sample_keep = one_in > 1 ? std::max<uint64_t>(1, units / one_in) : units;
+    sample_buckets = (unsigned)std::min<uint64_t>(sample_keep, SAMPLE_MAX_BUCKETS);
+    sample_stats.assign(sample_buckets, sim_stats_t());
+    bool on = sample_keep < units;
+    sample_l1 = on && config.l2_config.disabled;
+    sample_l2 = on && !config.l2_config.disabled;
+}
+
+// Rank of the sampling unit holding block_addr; sampled if < sample_keep
+uint64_t CacheSimulator::sample_rank(uint64_t block_addr) const {
+    uint64_t unit = (block_addr >> sample_run_bits) & ((1ULL << sample_unit_bits) - 1);
+    return unit_rank(unit, sample_unit_bits);
+}
+
+// L1 set sampling: simulate one access if it falls in a sampled set,
+// charging it to that unit's bucket; all accesses are counted in stats
+void CacheSimulator::sampled_access(char rw, uint64_t addr, sim_stats_t *stats) {
+    stats->accesses_l1++;
+    if (rw == READ) {
+        stats->reads++;
+    } else {
+        stats->writes++;
+    }
+    uint64_t rank = sample_rank(addr >> l1_b_bits);
+    if (rank < sample_keep) {
+        (this->*access_fn)(rw, addr, warming ? stats : &sample_stats[rank % sample_buckets]);
+    }
+}
+
+void CacheSimulator::sampled_batch(const access_t *recs, size_t n, sim_stats_t *stats) {
+    for (size_t i = 0; i < n; i++) {
+        sampled_access((recs[i] & ACCESS_WRITE_BIT) ? WRITE : READ, recs[i] & ACCESS_ADDR_MASK, stats);
+    }
+}
+
+static inline uint64_t scaled(uint64_t count, double scale) {
+    return (uint64_t)llround(count * scale);
+}
+
+// Fill in the estimated counters of stats from the buckets, scaled by
+// (all events / simulated events) of the sampled level: a ratio estimator
+void CacheSimulator::finish_sampled(sim_stats_t *stats) const {
+    sim_stats_t sum;
+    memset(&sum, 0, sizeof sum);
+    for (const sim_stats_t &b : sample_stats) {
+        sum.accesses_l1 += b.accesses_l1;
+        sum.hits_l1 += b.hits_l1;
+        sum.write_backs_l1 += b.write_backs_l1;
+        sum.read_hits_l2 += b.read_hits_l2;
+        sum.read_misses_l2 += b.read_misses_l2;
+        sum.prefetches_issued_l2 += b.prefetches_issued_l2;
+        sum.prefetch_hits_l2 += b.prefetch_hits_l2;
+        sum.prefetch_misses_l2 += b.prefetch_misses_l2;
+    }
+    if (sample_l1) {
+        // L2 is disabled, so every miss is an L2 read miss and a write-back
+        // an L2 write
+        double scale = sum.accesses_l1 ? (double)stats->accesses_l1 / sum.accesses_l1 : 0.0;
+        stats->hits_l1 = std::min(scaled(sum.hits_l1, scale), stats->accesses_l1);
+        stats->misses_l1 = stats->accesses_l1 - stats->hits_l1;
+        stats->write_backs_l1 = scaled(sum.write_backs_l1, scale);
+        stats->reads_l2 = stats->misses_l1;
+        stats->read_misses_l2 = stats->misses_l1;
+        stats->writes_l2 = stats->write_backs_l1;
+    } else {
+        // L1 counters and L2 reads/writes are exact
+        uint64_t simulated = sum.read_hits_l2 + sum.read_misses_l2;
+        double scale = simulated ? (double)stats->reads_l2 / simulated : 0.0;
+        stats->read_hits_l2 = std::min(scaled(sum.read_hits_l2, scale), stats->reads_l2);
+        stats->read_misses_l2 = stats->reads_l2 - stats->read_hits_l2;
+        stats->prefetches_issued_l2 = scaled(sum.prefetches_issued_l2, scale);
+        stats->prefetch_hits_l2 = scaled(sum.prefetch_hits_l2, scale);
+        stats->prefetch_misses_l2 = scaled(sum.prefetch_misses_l2, scale);
+    }
+}
+
+// Ratio estimate sum(num) / sum(den) over the buckets, with a 95%
+// confidence half-width from the spread between buckets
+static sim_estimate_t ratio_estimate(const std::vector<double> &num, const std::vector<double> &den) {
+    sim_estimate_t est = {0.0, NAN};
+    double total_num = 0, total_den = 0;
+    size_t k = num.size();
+    for (size_t j = 0; j < k; j++) {
+        total_num += num[j];
+        total_den += den[j];
+    }
+    if (total_den <= 0) {
+        return est;
+    }
+    est.mean = total_num / total_den;
+    if (k < 2) {
+        return est;
+    }
+    double mean_den = total_den / k;
+    double var = 0;
+    for (size_t j = 0; j < k; j++) {
+        double resid = (num[j] - est.mean * den[j]) / mean_den;
+        var += resid * resid;
+    }
+    var /= (double)k * (k - 1);
+    est.ci95 = 1.96 * sqrt(var);
+    return est;
+}
+
+void CacheSimulator::sample_report(const sim_stats_t *stats, sim_sample_stats_t *out) const {
+    memset(out, 0, sizeof *out);
+    out->level = sample_l1 ? 1 : 2;
+    out->sets = sample_l1 ? l1_sets : l2_sets;
+    out->sampled_sets = (out->sets >> sample_unit_bits) * sample_keep;
+    out->total = sample_l1 ? stats->accesses_l1 : stats->reads_l2;
+    out->buckets = sample_buckets;
+
+    std::vector<double> acc, hits, reads_l2, read_hits_l2, aat;
+    for (const sim_stats_t &b : sample_stats) {
+        out->simulated += sample_l1 ? b.accesses_l1 : b.read_hits_l2 + b.read_misses_l2;
+        sim_stats_t s = b;
+        s.misses_l1 = s.accesses_l1 - s.hits_l1;
+        s.reads_l2 = s.misses_l1;
+        s.read_misses_l2 = s.misses_l1;
+        finish_stats(config, &s);
+        acc.push_back((double)b.accesses_l1);
+        hits.push_back((double)b.hits_l1);
+        reads_l2.push_back((double)(b.read_hits_l2 + b.read_misses_l2));
+        read_hits_l2.push_back((double)b.read_hits_l2);
+        // an access-weighted mean of per-bucket AATs
+        aat.push_back(s.avg_access_time_l1 * b.accesses_l1);
+    }
+
+    if (sample_l1) {
+        out->hit_ratio_l1 = ratio_estimate(hits, acc);
+        out->read_hit_ratio_l2.mean = 0.0;
+        out->read_hit_ratio_l2.ci95 = 0.0;
+        out->avg_access_time_l1 = ratio_estimate(aat, acc);
+    } else {
+        // L1 AAT = HT1 + MR1 * (HT2 + (1 - HR2) * DRAM), so only the L2
+        // read hit ratio carries sampling error
+        double dram_time = DRAM_AT + ((double)(1ULL << config.l1_config.b) / WORD_SIZE) * DRAM_AT_PER_WORD;
+        out->hit_ratio_l1.mean = stats->hit_ratio_l1;
+        out->hit_ratio_l1.ci95 = 0.0;
+        out->read_hit_ratio_l2 = ratio_estimate(read_hits_l2, reads_l2);
+        out->avg_access_time_l1.mean = stats->avg_access_time_l1;
+        out->avg_access_time_l1.ci95 = stats->miss_ratio_l1 * dram_time * out->read_hit_ratio_l2.ci95;
+    }
+}
+
+/* Time sampling */
+
+void CacheSimulator::begin_window(const sim_stats_t *stats) {
+    window_start = *stats;
+}
+
+void CacheSimulator::end_window(sim_stats_t *stats) {
+    sim_stats_t w;
+    memset(&w, 0, sizeof w);
+    w.accesses_l1 = stats->accesses_l1 - window_start.accesses_l1;
+    w.hits_l1 = stats->hits_l1 - window_start.hits_l1;
+    w.misses_l1 = stats->misses_l1 - window_start.misses_l1;
+    w.reads_l2 = stats->reads_l2 - window_start.reads_l2;
+    w.read_hits_l2 = stats->read_hits_l2 - window_start.read_hits_l2;
+    w.read_misses_l2 = stats->read_misses_l2 - window_start.read_misses_l2;
+    window_stats.push_back(w);
+    stats->windows++;
+}
+
+void CacheSimulator::window_report(sim_window_stats_t *out) const {
+    memset(out, 0, sizeof *out);
+    out->windows = window_stats.size();
+
+    // each window is one observation of the ratio estimators; AAT is the
+    // access-weighted mean of the per-window AATs
+    std::vector<double> acc, hits, reads_l2, read_hits_l2, aat;
+    for (const sim_stats_t &w : window_stats) {
+        out->measured += w.accesses_l1;
+        sim_stats_t s = w;
+        finish_stats(config, &s);
+        acc.push_back((double)w.accesses_l1);
+        hits.push_back((double)w.hits_l1);
+        reads_l2.push_back((double)w.reads_l2);
+        read_hits_l2.push_back((double)w.read_hits_l2);
+        aat.push_back(s.avg_access_time_l1 * w.accesses_l1);
+    }
+    out->hit_ratio_l1 = ratio_estimate(hits, acc);
+    out->read_hit_ratio_l2 = ratio_estimate(read_hits_l2, reads_l2);
+    out->avg_access_time_l1 = ratio_estimate(aat, acc);
+
+    // the half-width shrinks as 1/sqrt(windows)
+    const sim_estimate_t &est = out->avg_access_time_l1;
+    if (!std::isnan(est.ci95) && est.mean > 0) {
+        double rel = est.ci95 / est.mean / 0.03;
+        out->windows_for_3pct = (uint64_t)ceil(out->windows * rel * rel);
+    }
+}
+
+/* Instrumentation */
+
+#ifdef CACHESIM_INSTRUMENT
+bool CacheSimulator::instrument_report(sim_instrument_stats_t *out, std::string *) const {
+    l1_instrument.report(&out->l1);
+    l2_instrument.report(&out->l2);
+    return true;
+}
+
+bool CacheSimulator::instrument_dump(const std::string &prefix, std::string *error) const {
+    return l1_instrument.dump(prefix + "_l1", error)
+        && (config.l2_config.disabled || l2_instrument.dump(prefix + "_l2", error));
+}
+#else
+static const char NOT_INSTRUMENTED[] = "not built with instrumentation (make INSTRUMENT=1)";
+
+bool CacheSimulator::instrument_report(sim_instrument_stats_t *, std::string *error) const {
+    if (error) {
+        *error = NOT_INSTRUMENTED;
+    }
+    return false;
+}
+
+bool CacheSimulator::instrument_dump(const std::string &, std::string *error) const {
+    if (error) {
+        *error = NOT_INSTRUMENTED;
+    }
+    return false;
+}
+#endif
+
+/* Checkpoints */
+
+// Checkpoint file format
+// ----------------------
+// A checkpoint_header_t, then in order:
+//   sim_stats_t (stats_size bytes)
+//   L1: l1_timestamp, storage_words, the CacheArray storage
+//   L2: l2_mru_counter, l2_lip_counter, storage_words, the storage
+//   Markov: rows_used, lru_head, lru_tail, has_prev_block, prev_block_addr,
+//     then MarkovRow[rows_used]; the index is rebuilt on restore
+//   set sampling: sample_l1, sample_l2, unit_bits, run_bits, keep,
+//     n_buckets, then sim_stats_t[n_buckets]
+//   time sampling: window_start, n_windows, then sim_stats_t[n_windows]
+// Integers are uint64_t in host byte order; checkpoints are meant to be
+// restored by the same build on the same kind of machine.
+static const char CHECKPOINT_MAGIC[8] = {'C', 'S', 'I', 'M', 'C', 'K', 'P', 'T'};
+static const uint32_t CHECKPOINT_VERSION = 1;
+
+typedef struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t stats_size;
+    uint64_t trace_offset;
+    uint64_t config[SIM_CONFIG_WORDS];
+} checkpoint_header_t;
+
+static bool put_words(FILE *out, const void *data, size_t bytes) {
+    return fwrite(data, 1, bytes, out) == bytes;
+}
+
+static bool put_word(FILE *out, uint64_t value) {
+    return put_words(out, &value, sizeof value);
+}
+
+static bool get_words(FILE *in, void *data, size_t bytes) {
+    return fread(data, 1, bytes, in) == bytes;
+}
+
+static bool get_word(FILE *in, uint64_t *value) {
+    return get_words(in, value, sizeof *value);
+}
+
+// Bytes between in's position and its end; UINT64_MAX if in cannot seek
+static uint64_t bytes_left(FILE *in) {
+    long pos = ftell(in);
+    if (pos < 0 || fseek(in, 0, SEEK_END)) {
+        return UINT64_MAX;
+    }
+    long end = ftell(in);
+    if (end < 0 || fseek(in, pos, SEEK_SET)) {
+        return UINT64_MAX;
+    }
+    return end > pos ? (uint64_t)(end - pos) : 0;
+}
+
+// Whether rows[0, rows_used) form one LRU list from head to tail, with
+// every link and entry count in range, so the prefetcher never follows a
+// link out of the table
+static bool markov_rows_valid(const MarkovRow *rows, uint64_t rows_used, uint64_t head, uint64_t tail) {
+    if (rows_used == 0) {
+        return head == MARKOV_NONE && tail == MARKOV_NONE;
+    }
+    if (head >= rows_used || tail >= rows_used) {
+        return false;
+    }
+    for (uint64_t i = 0; i < rows_used; i++) {
+        const MarkovRow &r = rows[i];
+        if (r.n_entries > MARKOV_ENTRIES || (r.prev != MARKOV_NONE && r.prev >= rows_used)
+            || (r.next != MARKOV_NONE && r.next >= rows_used)) {
+            return false;
+        }
+    }
+    // each row's prev must be the row the walk came from, so no row is
+    // visited twice and rows_used steps cover the whole table
+    uint64_t row = head, prev = MARKOV_NONE, steps = 0;
+    while (row != MARKOV_NONE && steps < rows_used) {
+        if (rows[row].prev != prev) {
+            return false;
+        }
+        prev = row;
+        row = rows[row].next;
+        steps++;
+    }
+    return row == MARKOV_NONE && steps == rows_used && prev == tail;
+}
+
+bool CacheSimulator::save_checkpoint(FILE *out, uint64_t trace_offset, const sim_stats_t *stats,
+                                     std::string *error) const {
+    checkpoint_header_t header;
+    memset(&header, 0, sizeof header);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof header.magic);
+    header.version = CHECKPOINT_VERSION;
+    header.stats_size = sizeof *stats;
+    header.trace_offset = trace_offset;
+    pack_config(config, header.config);
+
+    bool ok = put_words(out, &header, sizeof header)
+        && put_words(out, stats, sizeof *stats)
+        && put_word(out, l1_timestamp)
+        && put_word(out, l1.storage_words)
+        && put_words(out, l1.storage, l1.storage_words * sizeof(uint64_t))
+        && put_word(out, l2_mru_counter)
+        && put_word(out, l2_lip_counter)
+        && put_word(out, l2.storage_words)
+        && put_words(out, l2.storage, l2.storage_words * sizeof(uint64_t))
+        && put_word(out, markov_rows_used)
+        && put_word(out, markov_lru_head)
+        && put_word(out, markov_lru_tail)
+        && put_word(out, has_prev_block)
+        && put_word(out, prev_block_addr)
+        && put_words(out, markov_rows, markov_rows_used * sizeof(MarkovRow))
+        && put_word(out, sample_l1)
+        && put_word(out, sample_l2)
+        && put_word(out, sample_unit_bits)
+        && put_word(out, sample_run_bits)
+        && put_word(out, sample_keep)
+        && put_word(out, sample_stats.size())
+        && put_words(out, sample_stats.data(), sample_stats.size() * sizeof(sim_stats_t))
+        && put_words(out, &window_start, sizeof window_start)
+        && put_word(out, window_stats.size())
+        && put_words(out, window_stats.data(), window_stats.size() * sizeof(sim_stats_t));
+    if (!ok && error) {
+        *error = "cannot write checkpoint";
+    }
+    return ok;
+}
+
+checkpoint_restore_t CacheSimulator::restore_checkpoint(FILE *in, uint64_t *trace_offset, sim_stats_t *stats,
+                                                        std::string *error) {
+    std::string msg;
+    checkpoint_header_t header;
+    uint64_t ours[SIM_CONFIG_WORDS];
+    pack_config(config, ours);
+    uint64_t half = SIM_CONFIG_WORDS / 2 * sizeof(uint64_t);
+
+    uint64_t timestamp = 0, words = 0;
+    if (!get_words(in, &header, sizeof header)
+        || memcmp(header.magic, CHECKPOINT_MAGIC, sizeof header.magic)) {
+        msg = "not a cachesim checkpoint";
+    } else if (header.version != CHECKPOINT_VERSION || header.stats_size != sizeof *stats) {
+        msg = "checkpoint was written by a different version of cachesim";
+    } else if (memcmp(header.config, ours, half)) {
+        msg = "checkpoint has a different L1 configuration";
+    } else if (!get_words(in, stats, sizeof *stats)
+               || !get_word(in, &timestamp)
+               || !get_word(in, &words) || words != l1.storage_words
+               || !get_words(in, l1.storage, words * sizeof(uint64_t))) {
+        msg = "truncated or corrupt checkpoint";
+    }
+    if (!msg.empty()) {
+        if (error) {
+            *error = msg;
+        }
+        return CHECKPOINT_FAILED;
+    }
+    l1_timestamp = timestamp;
+    *trace_offset = header.trace_offset;
+
+    if (memcmp(header.config + SIM_CONFIG_WORDS / 2, ours + SIM_CONFIG_WORDS / 2, half)) {
+        memset(stats, 0, sizeof *stats);
+        return CHECKPOINT_L1_ONLY;
+    }
+
+    // read everything into locals first; nothing past L1 is committed
+    // until the whole image has been checked
+    uint64_t mru = 0, lip = 0, rows_used = 0, head = 0, tail = 0, has_prev = 0, prev_addr = 0, n = 0;
+    uint64_t s_l1 = 0, s_l2 = 0, s_unit = 0, s_run = 0, s_keep = 0;
+    std::vector<MarkovRow> rows;
+    bool ok = get_word(in, &mru)
+        && get_word(in, &lip)
+        && get_word(in, &words) && words == l2.storage_words
+        && get_words(in, l2.storage, words * sizeof(uint64_t))
+        && get_word(in, &rows_used) && rows_used <= n_markov_rows
+        && get_word(in, &head)
+        && get_word(in, &tail)
+        && get_word(in, &has_prev)
+        && get_word(in, &prev_addr);
+    if (ok) {
+        rows.resize(rows_used);
+        ok = get_words(in, rows.data(), rows_used * sizeof(MarkovRow))
+            && markov_rows_valid(rows.data(), rows_used, head, tail);
+    }
+    ok = ok && get_word(in, &s_l1)
+        && get_word(in, &s_l2)
+        && get_word(in, &s_unit)
+        && get_word(in, &s_run)
+        && get_word(in, &s_keep)
+        && get_word(in, &n);
+    if (ok && (s_l1 != sample_l1 || s_l2 != sample_l2 || s_unit != sample_unit_bits
+               || s_run != sample_run_bits || s_keep != sample_keep || n != sample_stats.size())) {
+        if (error) {
+            *error = "checkpoint was taken with different set sampling";
+        }
+        return CHECKPOINT_FAILED;
+    }
+    std::vector<sim_stats_t> samples(sample_stats.size()), windows;
+    sim_stats_t start;
+    ok = ok && get_words(in, samples.data(), n * sizeof(sim_stats_t))
+        && get_words(in, &start, sizeof start)
+        && get_word(in, &n) && n <= bytes_left(in) / sizeof(sim_stats_t);
+    // in chunks, so a stream that cannot seek still only grows the vector
+    // as far as it has data
+    while (ok && windows.size() < n) {
+        size_t len = (size_t)std::min<uint64_t>(n - windows.size(), 4096);
+        windows.resize(windows.size() + len);
+        ok = get_words(in, &windows[windows.size() - len], len * sizeof(sim_stats_t));
+    }
+    if (!ok) {
+        if (error) {
+            *error = "truncated or corrupt checkpoint";
+        }
+        return CHECKPOINT_FAILED;
+    }
+
+    l2_mru_counter = mru;
+    l2_lip_counter = lip;
+    std::copy(rows.begin(), rows.end(), markov_rows);
+    markov_rows_used = (uint32_t)rows_used;
+    markov_lru_head = (uint32_t)head;
+    markov_lru_tail = (uint32_t)tail;
+    has_prev_block = has_prev != 0;
+    prev_block_addr = prev_addr;
+    std::fill(markov_index, markov_index + (1ULL << markov_index_bits), MARKOV_NONE);
+    for (uint32_t row = 0; row < markov_rows_used; row++) {
+        markov_index_insert(row);
+    }
+    sample_stats.swap(samples);
+    window_start = start;
+    window_stats.swap(windows);
+    return CHECKPOINT_RESTORED;
+}
+
+// Compatibility entry points; they drive one process-wide simulator
+static CacheSimulator *default_sim = NULL;
+
+void sim_setup(sim_config_t *config) {
+    delete default_sim;
+    default_sim = new CacheSimulator(*config);
+}
+
+void sim_access(char rw, uint64_t addr, sim_stats_t* p_stats) {
+    default_sim->access(rw, addr, p_stats);
+}
+
+void sim_access_batch(const access_t *recs, size_t n, sim_stats_t *p_stats) {
+    default_sim->access_batch(recs, n, p_stats);
+}
+
+void sim_sample_sets(uint64_t one_in) {
+    default_sim->sample_sets(one_in);
+}
+
+void sim_sample_report(const sim_stats_t *stats, sim_sample_stats_t *out) {
+    default_sim->sample_report(stats, out);
+}
+
+void sim_warm_batch(const access_t *recs, size_t n) {
+    default_sim->warm(recs, n);
+}
+
+void sim_window_begin(const sim_stats_t *stats) {
+    default_sim->begin_window(stats);
+}
+
+void sim_window_end(sim_stats_t *stats) {
+    default_sim->end_window(stats);
+}
+
+void sim_window_report(sim_window_stats_t *out) {
+    default_sim->window_report(out);
+}
+
+int sim_checkpoint_save(const char *path, uint64_t trace_offset, const sim_stats_t *stats) {
+    // write next to the target and rename, so a crash never leaves a
+    // half-written checkpoint behind
+    std::string tmp = std::string(path) + ".tmp";
+    FILE *out = fopen(tmp.c_str(), "wb");
+    if (!out) {
+        perror(tmp.c_str());
+        return 1;
+    }
+    std::string error;
+    bool ok = default_sim->save_checkpoint(out, trace_offset, stats, &error);
+    if (fclose(out) != 0 && ok) {
+        ok = false;
+        error = "cannot write checkpoint";
+    }
+    if (ok && rename(tmp.c_str(), path) != 0) {
+        ok = false;
+        error = std::string("cannot rename to ") + path;
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", tmp.c_str(), error.c_str());
+        remove(tmp.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+checkpoint_restore_t sim_checkpoint_restore(const char *path, uint64_t *trace_offset, sim_stats_t *stats) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return CHECKPOINT_FAILED;
+    }
+    std::string error;
+    checkpoint_restore_t result = default_sim->restore_checkpoint(in, trace_offset, stats, &error);
+    fclose(in);
+    if (result == CHECKPOINT_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+    }
+    return result;
+}
+
+int sim_instrument_report(sim_instrument_stats_t *out) {
+    std::string error;
+    if (!default_sim->instrument_report(out, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+int sim_instrument_dump(const char *prefix) {
+    std::string error;
+    if (!default_sim->instrument_dump(prefix, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+void sim_finish(sim_stats_t *p_stats) {
+    default_sim->finish(p_stats);
+}
@@ -1,9 +1,12 @@
 #ifndef CACHESIM_HPP
 #define CACHESIM_HPP
 
+#ifdef __cplusplus
 #include <cstdint>
+#endif
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 // Replacement policy
 typedef enum replacement_policy {
@@ -76,12 +79,112 @@ typedef struct sim_stats {
     uint64_t prefetches_issued_l2;
     uint64_t prefetch_hits_l2;
     uint64_t prefetch_misses_l2;
+    // Time sampling: measurement windows these counters cover (0 when
+    // they cover every simulated access)
+    uint64_t windows;
 } sim_stats_t;
 
+// One packed access for sim_access_batch(): bits 0-62 hold the address and
+// bit 63 is set for a write. Raw binary traces store exactly this.
+typedef uint64_t access_t;
+#ifdef __cplusplus
+static const uint64_t ACCESS_WRITE_BIT = 1ULL << 63;
+static const uint64_t ACCESS_ADDR_MASK = ACCESS_WRITE_BIT - 1;
+#endif
+
 extern void sim_setup(sim_config_t *config);
 extern void sim_access(char rw, uint64_t addr, sim_stats_t* p_stats);
+// Equivalent to sim_access() on each of recs[0, n) in order, but faster
+extern void sim_access_batch(const access_t *recs, size_t n, sim_stats_t *p_stats);
 extern void sim_finish(sim_stats_t *p_stats);
 
+// An estimate and the half-width of its 95% confidence interval (NaN when
+// there are too few samples to tell)
+typedef struct sim_estimate {
+    double mean;
+    double ci95;
+} sim_estimate_t;
+
+// Set sampling results. One level is sampled: L2, or L1 if L2 is disabled.
+typedef struct sim_sample_stats {
+    unsigned level;
+    uint64_t sets;
+    uint64_t sampled_sets;
+    // accesses to the sampled level (L1 accesses or L2 reads)
+    uint64_t total;
+    uint64_t simulated;
+    unsigned buckets;
+    sim_estimate_t hit_ratio_l1;
+    sim_estimate_t read_hit_ratio_l2;
+    sim_estimate_t avg_access_time_l1;
+} sim_sample_stats_t;
+
+// Set sampling for the default simulator: call after sim_setup() to only
+// simulate about 1/one_in of the sets; sim_finish() then extrapolates
+extern void sim_sample_sets(uint64_t one_in);
+// Confidence intervals for the stats sim_finish() produced
+extern void sim_sample_report(const sim_stats_t *stats, sim_sample_stats_t *out);
+
+// Time sampling results: per-window estimates over the measurement windows
+typedef struct sim_window_stats {
+    uint64_t windows;
+    // accesses inside windows
+    uint64_t measured;
+    sim_estimate_t hit_ratio_l1;
+    sim_estimate_t read_hit_ratio_l2;
+    sim_estimate_t avg_access_time_l1;
+    // windows needed for a +/-3% (95% confidence) L1 AAT estimate, going
+    // by the variation seen so far; 0 if unknown
+    uint64_t windows_for_3pct;
+} sim_window_stats_t;
+
+// Time sampling for the default simulator. sim_warm_batch() updates the
+// cache and prefetcher state like sim_access_batch() without counting
+// anything (functional warming). Accesses simulated between
+// sim_window_begin() and sim_window_end() form one measurement window.
+// Warming works under set sampling; windows do not.
+extern void sim_warm_batch(const access_t *recs, size_t n);
+extern void sim_window_begin(const sim_stats_t *stats);
+extern void sim_window_end(sim_stats_t *stats);
+// Confidence intervals from the spread between windows
+extern void sim_window_report(sim_window_stats_t *out);
+
+// Checkpoints of the default simulator's state. sim_checkpoint_save()
+// records the trace position the caller has reached and writes the file
+// atomically (a temporary file renamed over path); it returns 0 on success.
+// See CacheSimulator::restore_checkpoint() for partial restores.
+typedef enum checkpoint_restore {
+    CHECKPOINT_FAILED,
+    // everything, including the statistics
+    CHECKPOINT_RESTORED,
+    // only the L1 state: the L2 configuration differs
+    CHECKPOINT_L1_ONLY
+} checkpoint_restore_t;
+extern int sim_checkpoint_save(const char *path, uint64_t trace_offset, const sim_stats_t *stats);
+extern checkpoint_restore_t sim_checkpoint_restore(const char *path, uint64_t *trace_offset,
+                                                   sim_stats_t *stats);
+
+// Three-C miss classification, from builds with `make INSTRUMENT=1`
+typedef struct sim_miss_classes {
+    uint64_t compulsory;
+    uint64_t capacity;
+    uint64_t conflict;
+} sim_miss_classes_t;
+typedef struct sim_instrument_stats {
+    sim_miss_classes_t l1;
+    // L2 read misses
+    sim_miss_classes_t l2;
+} sim_instrument_stats_t;
+// Both return nonzero in builds without instrumentation. sim_instrument_dump()
+// writes per-set and per-frame heat maps to prefix_l1_*.csv and
+// prefix_l2_*.csv.
+extern int sim_instrument_report(sim_instrument_stats_t *out);
+extern int sim_instrument_dump(const char *prefix);
+
+// The types above are plain C, so libcachesim.h can share them; the
+// constants below are only for the simulator itself
+#ifdef __cplusplus
+
 // Sorry about the /* comments */. C++11 cannot handle basic C99 syntax,
 // unfortunately
 static const sim_config_t DEFAULT_SIM_CONFIG = {
@@ -122,4 +225,6 @@ static const double L1_HIT_TIME_PER_S = 0.2;
 static const double L2_HIT_TIME_CONST = 8;
 static const double L2_HIT_TIME_PER_S = 0.8;
 
+#endif /* __cplusplus */
+
 #endif /* CACHESIM_HPP */
@@ -0,0 +1,383 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "cachesim.hpp"
+#include "cache_simulator.hpp"
+#include "trace.hpp"
+#include "trace_gen.hpp"
+
+// Configurations from the validation scripts, plus the sweep corners
+struct BenchConfig {
+    const char *name;
+    sim_config_t config;
+};
+
+static std::vector<BenchConfig> bench_configs(void);
+static void print_help(void);
+
+// One measured benchmark: a microbenchmark or a trace/config pair
+struct BenchResult {
+    std::string name;
+    double ns;
+};
+static int run_micro(int reps, std::vector<BenchResult> &results);
+static int write_results(const char *path, const std::vector<BenchResult> &results);
+static int compare_baseline(const char *path, const std::vector<BenchResult> &results, double threshold);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Best-of-reps nanoseconds per access for one simulator flavour: the
+// generic or specialized kernel, one access() call per record or a single
+// access_batch() over the whole trace
+static double time_kernel(const sim_config_t &config, bool specialize, bool batch,
+                          const std::vector<uint64_t> &recs, int reps, sim_stats_t *stats) {
+    double best = 0;
+    for (int i = 0; i < reps; i++) {
+        CacheSimulator sim(config, specialize);
+        memset(stats, 0, sizeof *stats);
+        double start = now();
+        if (batch) {
+            sim.access_batch(recs.data(), recs.size(), stats);
+        } else {
+            for (uint64_t rec : recs) {
+                sim.access(trace_rw(rec), trace_addr(rec), stats);
+            }
+        }
+        double ns = (now() - start) * 1e9 / (recs.empty() ? 1 : recs.size());
+        if (i == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int reps = 3;
+    bool micro = true;
+    const char *out_path = NULL;
+    const char *baseline_path = NULL;
+    double threshold = 10;
+    std::vector<std::string> gen_specs;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt(argc, argv, "n:Mo:b:t:g:h"))) {
+        switch(opt) {
+        case 'n':
+            reps = atoi(optarg);
+            break;
+        case 'M':
+            micro = false;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'b':
+            baseline_path = optarg;
+            break;
+        case 't':
+            threshold = atof(optarg);
+            break;
+        case 'g':
+            gen_specs.push_back(optarg);
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+    if ((!micro && optind == argc && gen_specs.empty()) || reps < 1 || threshold < 0) {
+        print_help();
+        return 1;
+    }
+
+    std::vector<BenchResult> results;
+    if (micro && run_micro(reps, results)) {
+        return 1;
+    }
+
+    std::vector<BenchConfig> configs = bench_configs();
+
+    // Trace files, then generated traces
+    std::vector<std::string> traces(argv + optind, argv + argc);
+    traces.insert(traces.end(), gen_specs.begin(), gen_specs.end());
+    size_t n_files = argc - optind;
+
+    if (!traces.empty()) {
+        printf("%s%-24s %-16s %12s %12s %12s %8s\n", micro ? "\n" : "", "trace", "config", "generic ns",
+               "special ns", "batch ns", "speedup");
+    }
+    for (size_t t = 0; t < traces.size(); t++) {
+        std::vector<uint64_t> recs;
+        std::string name;
+        if (t < n_files) {
+            if (trace_load(traces[t].c_str(), recs)) {
+                fprintf(stderr, "%s: cannot read trace\n", traces[t].c_str());
+                return 1;
+            }
+            size_t slash = traces[t].rfind('/');
+            name = slash == std::string::npos ? traces[t] : traces[t].substr(slash + 1);
+        } else {
+            TraceGenSpec spec;
+            std::string error;
+            if (!trace_gen_parse(traces[t].c_str(), &spec, &error)) {
+                fprintf(stderr, "%s: %s\n", traces[t].c_str(), error.c_str());
+                return 1;
+            }
+            TraceGenerator gen(spec);
+            recs.resize(spec.n);
+            gen.next(recs.data(), recs.size());
+            // The spec names the trace; its commas would split the CSV field
+            name = traces[t];
+            std::replace(name.begin(), name.end(), ',', ';');
+        }
+
+        for (const BenchConfig &bc : configs) {
+            sim_stats_t generic_stats, special_stats, batch_stats;
+            double generic = time_kernel(bc.config, false, false, recs, reps, &generic_stats);
+            double special = time_kernel(bc.config, true, false, recs, reps, &special_stats);
+            double batch = time_kernel(bc.config, true, true, recs, reps, &batch_stats);
+            if (memcmp(&generic_stats, &special_stats, sizeof generic_stats)) {
+                fprintf(stderr, "%s %s: specialized kernel disagrees with the generic one\n", name.c_str(), bc.name);
+                return 1;
+            }
+            if (memcmp(&generic_stats, &batch_stats, sizeof generic_stats)) {
+                fprintf(stderr, "%s %s: batch kernel disagrees with the generic one\n", name.c_str(), bc.name);
+                return 1;
+            }
+            printf("%-24s %-16s %12.2f %12.2f %12.2f %7.2fx\n", name.c_str(), bc.name, generic, special, batch,
+                   batch > 0 ? generic / batch : 0.0);
+            results.push_back(BenchResult{std::string("trace/") + name + "/" + bc.name, batch});
+        }
+    }
+
+    if (out_path && write_results(out_path, results)) {
+        return 1;
+    }
+    if (baseline_path) {
+        return compare_baseline(baseline_path, results, threshold);
+    }
+    return 0;
+}
+
+// Synthetic access streams, each built to keep the simulator on one path
+static std::vector<uint64_t> cyclic_stream(uint64_t n_blocks, uint64_t block_bytes, size_t n) {
+    std::vector<uint64_t> recs(n);
+    for (size_t i = 0; i < n; i++) {
+        recs[i] = (i % n_blocks) * block_bytes;
+    }
+    return recs;
+}
+
+static std::vector<uint64_t> strided_stream(uint64_t stride_bytes, size_t n) {
+    std::vector<uint64_t> recs(n);
+    for (size_t i = 0; i < n; i++) {
+        recs[i] = i * stride_bytes;
+    }
+    return recs;
+}
+
+// A fixed pseudo-random walk over n_blocks blocks, repeated, so every block
+// has one successor for the Markov table to learn
+static std::vector<uint64_t> markov_stream(uint64_t n_blocks, uint64_t block_bytes, size_t n) {
+    std::vector<uint64_t> order(n_blocks);
+    for (uint64_t i = 0; i < n_blocks; i++) {
+        order[i] = i;
+    }
+    uint64_t x = 0x9E3779B97F4A7C15ULL;
+    for (uint64_t i = n_blocks - 1; i > 0; i--) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        std::swap(order[i], order[x % (i + 1)]);
+    }
+    std::vector<uint64_t> recs(n);
+    for (size_t i = 0; i < n; i++) {
+        recs[i] = order[i % n_blocks] * block_bytes;
+    }
+    return recs;
+}
+
+static const size_t MICRO_ACCESSES = 1 << 20;
+
+static void add_micro(const char *name, const sim_config_t &config, const std::vector<uint64_t> &recs, int reps,
+                      std::vector<BenchResult> &results) {
+    sim_stats_t stats;
+    double ns = time_kernel(config, true, true, recs, reps, &stats);
+    printf("%-28s %12.2f %12.1f\n", name, ns, ns > 0 ? 1e3 / ns : 0.0);
+    results.push_back(BenchResult{std::string("micro/") + name, ns});
+}
+
+// The hot paths one at a time, on the specialized batch kernel
+static int run_micro(int reps, std::vector<BenchResult> &results) {
+    printf("%-28s %12s %12s\n", "microbenchmark", "ns/access", "M access/s");
+    char name[64];
+
+    // 8 blocks in a 16-block L1: every access hits
+    sim_config_t config = DEFAULT_SIM_CONFIG;
+    add_micro("l1_hit", config, cyclic_stream(8, 64, MICRO_ACCESSES), reps, results);
+
+    // 64 blocks cycled through a 16-block L1 and a 512-block L2: every
+    // access misses L1 and hits L2
+    add_micro("l1_miss_l2_hit", config, cyclic_stream(64, 64, MICRO_ACCESSES), reps, results);
+
+    // a stream that never repeats, L1 only: every access evicts, so this
+    // is pick_victim over a full set of 2^S ways
+    for (uint64_t s = 0; s <= 5; s++) {
+        config = DEFAULT_SIM_CONFIG;
+        config.l1_config.c = 14;
+        config.l1_config.s = s;
+        config.l2_config.disabled = 1;
+        snprintf(name, sizeof name, "pick_victim_s%" PRIu64, s);
+        add_micro(name, config, strided_stream(64, MICRO_ACCESSES), reps, results);
+    }
+
+    // every other block: each access misses both levels, and +1 installs
+    // the skipped block; the difference is prefetch_install_l2
+    config = DEFAULT_SIM_CONFIG;
+    add_micro("l2_miss", config, strided_stream(128, MICRO_ACCESSES), reps, results);
+    config.l2_config.prefetch_algorithm = PREFETCH_PLUS_ONE;
+    add_micro("l2_miss_prefetch_install", config, strided_stream(128, MICRO_ACCESSES), reps, results);
+
+    // a 64K-block walk misses L2 nearly always; each miss runs
+    // markov_predict and markov_update on a table of r rows (the largest
+    // tables learn the walk and turn some misses into prefetch hits)
+    config = DEFAULT_SIM_CONFIG;
+    config.l2_config.prefetch_algorithm = PREFETCH_MARKOV;
+    std::vector<uint64_t> walk = markov_stream(1 << 16, 64, MICRO_ACCESSES);
+    for (uint64_t rows : {16, 256, 4096, 65536}) {
+        config.l2_config.n_markov_rows = rows;
+        snprintf(name, sizeof name, "markov_r%" PRIu64, rows);
+        add_micro(name, config, walk, reps, results);
+    }
+    return 0;
+}
+
+// CSV: benchmark,ns_per_access,accesses_per_sec
+static int write_results(const char *path, const std::vector<BenchResult> &results) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    fprintf(f, "benchmark,ns_per_access,accesses_per_sec\n");
+    for (const BenchResult &r : results) {
+        fprintf(f, "%s,%.4f,%.0f\n", r.name.c_str(), r.ns, r.ns > 0 ? 1e9 / r.ns : 0.0);
+    }
+    if (fclose(f)) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+// Fail if any benchmark in both runs lost more than threshold percent of
+// its baseline throughput
+static int compare_baseline(const char *path, const std::vector<BenchResult> &results, double threshold) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    std::map<std::string, double> baseline;
+    char line[512];
+    while (fgets(line, sizeof line, f)) {
+        char *comma = strchr(line, ',');
+        if (!comma || !strncmp(line, "benchmark,", 10)) {
+            continue;
+        }
+        *comma = '\0';
+        baseline[line] = strtod(comma + 1, NULL);
+    }
+    fclose(f);
+
+    printf("\n%-40s %10s %10s %8s\n", "vs baseline", "base ns", "ns", "change");
+    int regressions = 0;
+    size_t compared = 0;
+    for (const BenchResult &r : results) {
+        auto it = baseline.find(r.name);
+        if (it == baseline.end() || it->second <= 0 || r.ns <= 0) {
+            continue;
+        }
+        compared++;
+        // throughput change; negative is slower
+        double change = (it->second / r.ns - 1) * 100;
+        bool regressed = change < -threshold;
+        regressions += regressed;
+        printf("%-40s %10.2f %10.2f %+7.1f%%%s\n", r.name.c_str(), it->second, r.ns, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    if (!compared) {
+        fprintf(stderr, "%s: no benchmarks in common with this run\n", path);
+        return 1;
+    }
+    if (regressions) {
+        printf("%d of %zu benchmarks lost more than %.1f%% throughput\n", regressions, compared, threshold);
+        return 1;
+    }
+    printf("no benchmark lost more than %.1f%% throughput\n", threshold);
+    return 0;
+}
+
+static std::vector<BenchConfig> bench_configs(void) {
+    std::vector<BenchConfig> configs;
+    BenchConfig bc;
+
+    bc.name = "l1";
+    bc.config = DEFAULT_SIM_CONFIG;
+    bc.config.l2_config.disabled = 1;
+    configs.push_back(bc);
+
+    bc.name = "l1_l2";
+    bc.config = DEFAULT_SIM_CONFIG;
+    configs.push_back(bc);
+
+    bc.name = "l1_l2_plus1";
+    bc.config.l2_config.prefetch_algorithm = PREFETCH_PLUS_ONE;
+    configs.push_back(bc);
+
+    bc.name = "l1_l2_markov";
+    bc.config.l2_config.prefetch_algorithm = PREFETCH_MARKOV;
+    bc.config.l2_config.n_markov_rows = 100;
+    configs.push_back(bc);
+
+    bc.name = "l1_l2_hybrid";
+    bc.config.l2_config.prefetch_algorithm = PREFETCH_HYBRID;
+    configs.push_back(bc);
+
+    bc.name = "dm_l1_32w_l2";
+    bc.config = DEFAULT_SIM_CONFIG;
+    bc.config.l1_config.c = 14;
+    bc.config.l1_config.s = 0;
+    bc.config.l2_config.c = 17;
+    bc.config.l2_config.s = 5;
+    configs.push_back(bc);
+
+    return configs;
+}
+
+static void print_help(void) {
+    printf("cachesim-bench [OPTIONS] [trace]...\n");
+    printf("Times the hot paths of the simulator on synthetic streams, then the generic, the\n");
+    printf("specialized and the batched access kernels on each trace\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-n N\t\tRepetitions per measurement, best one is reported (default 3)\n");
+    printf("-M\t\tSkip the microbenchmarks\n");
+    printf("-o FILE\t\tWrite the results as CSV (benchmark,ns_per_access,accesses_per_sec)\n");
+    printf("-b FILE\t\tCompare with a baseline written by -o; exit 1 on a regression\n");
+    printf("-t PCT\t\tThroughput loss counted as a regression (default 10)\n");
+    printf("-g SPEC\t\tAlso benchmark a trace generated in memory (see cachesim-gen -h); repeatable\n");
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "trace.hpp"
+
+static void print_help(void);
+
+int main(int argc, char **argv) {
+    uint32_t flags = 0;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt(argc, argv, "dh"))) {
+        switch(opt) {
+        case 'd':
+            flags |= TRACE_FLAG_DELTA;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+
+    if (argc - optind != 2) {
+        print_help();
+        return 1;
+    }
+    const char *in_path = argv[optind];
+    const char *out_path = argv[optind + 1];
+
+    int in_fd = strcmp(in_path, "-") ? open(in_path, O_RDONLY) : STDIN_FILENO;
+    if (in_fd < 0) {
+        perror(in_path);
+        return 1;
+    }
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, in_fd)) {
+        fprintf(stderr, "%s: %s\n", in_path, trace_reader_strerror(&reader));
+        return 1;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+
+    trace_writer_t writer;
+    if (trace_writer_open(&writer, out, flags)) {
+        fprintf(stderr, "%s: cannot write header\n", out_path);
+        return 1;
+    }
+
+    int failed = 0;
+    const uint64_t *recs;
+    size_t n;
+    while (!failed && (recs = trace_reader_next(&reader, &n))) {
+        for (size_t i = 0; i < n; i++) {
+            if (trace_writer_append(&writer, trace_rw(recs[i]), trace_addr(recs[i]))) {
+                fprintf(stderr, "%s: cannot write record %" PRIu64 "\n", out_path, writer.n_records);
+                failed = 1;
+                break;
+            }
+        }
+    }
+    if (reader.error) {
+        fprintf(stderr, "%s: %s\n", in_path, trace_reader_strerror(&reader));
+        failed = 1;
+    }
+    trace_reader_close(&reader);
+
+    if (trace_writer_close(&writer) || fclose(out) || failed) {
+        fprintf(stderr, "%s: conversion failed\n", out_path);
+        return 1;
+    }
+
+    printf("Wrote %" PRIu64 " records to %s\n", writer.n_records, out_path);
+    return 0;
+}
+
+static void print_help(void) {
+    printf("cachesim-convert [OPTIONS] <in.trace|-> <out.bin>\n");
+    printf("Converts a trace (text or binary, optionally gzip/xz/zstd-compressed) into the binary trace format read by cachesim\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-d\t\tDelta-encode addresses (smaller file, decoded while simulating)\n");
+}
@@ -3,7 +3,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include "cachesim.hpp"
+#include "trace.hpp"
+#include "trace_pipeline.hpp"
+#include "result_cache.hpp"
+#include "stats_output.hpp"
+#include "epoch_series.hpp"
+#include "trace_gen.hpp"
+#include "perf_counters.hpp"
+#include "arena.hpp"
 
 static void print_help(void);
 static int parse_replace_policy(const char *arg, replacement_policy_t *policy_out);
@@ -11,45 +25,227 @@ static int parse_prefetch_algo(const char *arg, prefetch_algo_t *pf_out);
 static int validate_config(sim_config_t *config);
 static void print_cache_config(cache_config_t *cache_config, const char *cache_name);
 static void print_statistics(sim_stats_t* stats);
+static int parse_only(void);
+static bool hash_trace_file(int fd, TraceHash *hash);
+static void print_pipeline_stats(const PipelineStats &ps);
+static void print_sample_stats(const sim_stats_t *stats);
+static void print_miss_classes(bool l2_enabled);
 
-int main(int argc, char **argv) {
-    sim_config_t config = DEFAULT_SIM_CONFIG;
+// SMARTS-style time sampling (-f, -i, -w, -W). The first fast_forward
+// references only warm the caches. After that, each period of references
+// ends with a window of `window` references measured in detail, preceded by
+// `warmup` warmed ones; the rest of the period is skipped outright.
+struct TimeSampling {
+    uint64_t fast_forward;
+    uint64_t period;
+    uint64_t window;
+    uint64_t warmup;
+    // progress through the trace
+    uint64_t pos;
+    uint64_t warmed;
+    uint64_t skipped;
+    bool in_window;
+};
+static void simulate(TimeSampling *ts, const uint64_t *recs, size_t n, sim_stats_t *stats);
+
+// --perf-paths: when set, measured accesses go through it one at a time
+static PathProfile *path_profile = NULL;
+static void access_batch(const uint64_t *recs, size_t n, sim_stats_t *stats) {
+    if (path_profile) {
+        path_profile->access_batch(recs, n, stats);
+    } else {
+        sim_access_batch(recs, n, stats);
+    }
+}
+
+// Checkpointing (-x, -X, -R): where to write checkpoints, and the input
+// records a restored checkpoint already covers
+struct Checkpointing {
+    const char *path;
+    uint64_t every;
+    uint64_t next;
+    uint64_t skip;
+};
+// Per-epoch statistics (-e, -E): the series, and where the next epoch ends
+struct Epochs {
+    EpochSeries series;
+    uint64_t length;
+    uint64_t next;
+};
+static int run_batch(TimeSampling *ts, Checkpointing *ck, Epochs *ep, const uint64_t *recs, size_t n,
+                     sim_stats_t *stats);
+static void print_time_sampling_stats(const TimeSampling &ts, bool l2_enabled);
+
+// Machine-readable output (--format, --append, --label)
+struct Output {
+    stats_format_t format;
+    const char *append_path;
+    const char *label;
+};
+static int output_result(const Output &out, const sim_config_t &config, sim_stats_t *stats);
+
+// Long options only; their codes sit above every short option
+enum {
+    OPT_FORMAT = 256,
+    OPT_APPEND,
+    OPT_LABEL,
+    OPT_PERF,
+    OPT_PERF_PATHS,
+    OPT_NO_HUGE_PAGES,
+};
+static const struct option LONG_OPTIONS[] = {
+    {"format", required_argument, NULL, OPT_FORMAT},
+    {"append", required_argument, NULL, OPT_APPEND},
+    {"label", required_argument, NULL, OPT_LABEL},
+    {"perf", no_argument, NULL, OPT_PERF},
+    {"perf-paths", no_argument, NULL, OPT_PERF_PATHS},
+    {"no-huge-pages", no_argument, NULL, OPT_NO_HUGE_PAGES},
+    {NULL, 0, NULL, 0},
+};
+
+// Everything the command line sets
+struct Options {
+    sim_config_t config;
+    bool parse_only;
+    bool pipelined;
+    uint64_t sample_one_in;
+    TimeSampling ts;
+    bool have_window, have_warmup;
+    Checkpointing ck;
+    const char *restore_path;
+    const char *results_dir;
+    uint64_t epoch_length;
+    const char *epochs_path;
+    bool generate;
+    TraceGenSpec gen_spec;
+    bool classify_misses;
+    const char *heat_map_prefix;
+    Output out;
+    bool have_format;
+    bool perf;
+    bool perf_paths;
+    bool no_huge_pages;
+};
+
+// Returns -1 to go on, or the status to exit with (after -h, or a bad
+// option value)
+static int parse_options(int argc, char **argv, Options *o) {
     int opt;
+    o->config = DEFAULT_SIM_CONFIG;
+    o->out = {STATS_FORMAT_TEXT, NULL, ""};
 
     /* Read arguments */
-    while(-1 != (opt = getopt(argc, argv, "c:b:s:C:S:P:F:r:Dh"))) {
+    while(-1 != (opt = getopt_long(argc, argv, "c:b:s:C:S:P:F:r:Dptk:f:i:w:W:x:X:R:m:e:E:MH:g:h", LONG_OPTIONS, NULL))) {
         switch(opt) {
         case 'c':
-            config.l1_config.c = atoi(optarg);
+            o->config.l1_config.c = atoi(optarg);
             break;
         case 'b':
-            config.l1_config.b = atoi(optarg);
-            config.l2_config.b = config.l1_config.b;
+            o->config.l1_config.b = atoi(optarg);
+            o->config.l2_config.b = o->config.l1_config.b;
             break;
         case 's':
-            config.l1_config.s = atoi(optarg);
+            o->config.l1_config.s = atoi(optarg);
             break;
         case 'C':
-            config.l2_config.c = atoi(optarg);
+            o->config.l2_config.c = atoi(optarg);
             break;
         case 'S':
-            config.l2_config.s = atoi(optarg);
+            o->config.l2_config.s = atoi(optarg);
             break;
         case 'P':
-            if (parse_replace_policy(optarg, &config.l2_config.replace_policy)) {
+            if (parse_replace_policy(optarg, &o->config.l2_config.replace_policy)) {
                 return 1;
             }
             break;
         case 'F':
-            if (parse_prefetch_algo(optarg, &config.l2_config.prefetch_algorithm)) {
+            if (parse_prefetch_algo(optarg, &o->config.l2_config.prefetch_algorithm)) {
                 return 1;
             }
             break;
         case 'r':
-            config.l2_config.n_markov_rows = atoi(optarg);
+            o->config.l2_config.n_markov_rows = atoi(optarg);
             break;
         case 'D':
-            config.l2_config.disabled = 1;
+            o->config.l2_config.disabled = 1;
+            break;
+        case 'p':
+            o->parse_only = true;
+            break;
+        case 't':
+            o->pipelined = true;
+            break;
+        case 'k':
+            o->sample_one_in = strtoull(optarg, NULL, 10);
+            break;
+        case 'f':
+            o->ts.fast_forward = strtoull(optarg, NULL, 10);
+            break;
+        case 'i':
+            o->ts.period = strtoull(optarg, NULL, 10);
+            break;
+        case 'w':
+            o->ts.window = strtoull(optarg, NULL, 10);
+            o->have_window = true;
+            break;
+        case 'W':
+            o->ts.warmup = strtoull(optarg, NULL, 10);
+            o->have_warmup = true;
+            break;
+        case 'x':
+            o->ck.path = optarg;
+            break;
+        case 'X':
+            o->ck.every = strtoull(optarg, NULL, 10);
+            break;
+        case 'R':
+            o->restore_path = optarg;
+            break;
+        case 'm':
+            o->results_dir = optarg;
+            break;
+        case 'e':
+            o->epoch_length = strtoull(optarg, NULL, 10);
+            break;
+        case 'E':
+            o->epochs_path = optarg;
+            break;
+        case 'g': {
+            std::string error;
+            if (!trace_gen_parse(optarg, &o->gen_spec, &error)) {
+                printf("Invalid trace spec '%s': %s\n", optarg, error.c_str());
+                return 1;
+            }
+            o->generate = true;
+            break;
+        }
+        case 'M':
+            o->classify_misses = true;
+            break;
+        case 'H':
+            o->heat_map_prefix = optarg;
+            break;
+        case OPT_FORMAT:
+            if (stats_parse_format(optarg, &o->out.format)) {
+                printf("Unknown output format '%s'\n", optarg);
+                return 1;
+            }
+            o->have_format = true;
+            break;
+        case OPT_APPEND:
+            o->out.append_path = optarg;
+            break;
+        case OPT_LABEL:
+            o->out.label = optarg;
+            break;
+        case OPT_PERF:
+            o->perf = true;
+            break;
+        case OPT_PERF_PATHS:
+            o->perf_paths = true;
+            break;
+        case OPT_NO_HUGE_PAGES:
+            o->no_huge_pages = true;
             break;
         case 'h':
             /* Fall through */
@@ -59,41 +255,552 @@ int main(int argc, char **argv) {
         }
     }
 
-    printf("Cache Settings\n");
-    printf("--------------\n");
-    print_cache_config(&config.l1_config, "L1");
-    print_cache_config(&config.l2_config, "L2");
-    printf("\n");
 
-    if (validate_config(&config)) {
+    if (o->parse_only) {
+        return -1;
+    }
+    if (o->out.append_path && !o->have_format) {
+        o->out.format = STATS_FORMAT_CSV;
+    }
+    if (o->out.append_path && o->out.format == STATS_FORMAT_TEXT) {
+        printf("Invalid configuration! --append needs a json, csv or bin format\n");
         return 1;
     }
+    return -1;
+}
+
+// Check the options against each other and fill in the defaults that
+// depend on others. Returns 0 if they make a valid run.
+static int check_options(Options *o) {
+    if (validate_config(&o->config)) {
+        return 1;
+    }
+    TimeSampling &ts = o->ts;
+    if (ts.period) {
+        if (!o->have_window) {
+            ts.window = std::min<uint64_t>(10000, ts.period);
+        }
+        if (!o->have_warmup) {
+            ts.warmup = ts.period - std::min(ts.window, ts.period);
+        }
+        if (!ts.window || ts.window > ts.period || ts.warmup > ts.period - ts.window) {
+            printf("Invalid time sampling! Need 0 < window <= period and warmup <= period - window\n");
+            return 1;
+        }
+        if (o->sample_one_in > 1) {
+            printf("Invalid configuration! Set sampling (-k) and time sampling (-i) cannot be combined\n");
+            return 1;
+        }
+    } else if (o->have_window || o->have_warmup) {
+        printf("Invalid time sampling! -w and -W need a sampling period (-i)\n");
+        return 1;
+    }
+    if (o->ck.every && !o->ck.path) {
+        printf("Invalid configuration! -X needs a checkpoint file (-x)\n");
+        return 1;
+    }
+    if (o->epochs_path && !o->epoch_length) {
+        o->epoch_length = 100000;
+    }
+    if (o->epoch_length && !o->epochs_path) {
+        printf("Invalid configuration! -e needs an epoch series file (-E)\n");
+        return 1;
+    }
+#ifndef CACHESIM_INSTRUMENT
+    if (o->classify_misses || o->heat_map_prefix) {
+        printf("Invalid configuration! -M and -H need a build with make INSTRUMENT=1\n");
+        return 1;
+    }
+#endif
+    if (o->generate && o->pipelined) {
+        printf("Invalid configuration! A generated trace (-g) has nothing to decode on a second thread (-t)\n");
+        return 1;
+    }
+    if (o->perf_paths && o->sample_one_in > 1) {
+        printf("Invalid configuration! --perf-paths and set sampling (-k) cannot be combined\n");
+        return 1;
+    }
+    if (o->epoch_length && o->sample_one_in > 1) {
+        // sampled counts only exist per bucket until sim_finish()
+        printf("Invalid configuration! Epochs (-E) and set sampling (-k) cannot be combined\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Result store (-m). Only complete, unsampled runs are stored.
+struct Memo {
+    ResultCache results;
+    TraceHash trace_hash;
+    // trace_hash is known before simulating; otherwise the hasher sees
+    // every batch
+    bool hashed;
+    TraceHasher hasher;
+};
+
+static bool memoizable(const Options &o) {
+    return o.results_dir && o.sample_one_in <= 1 && !o.ts.fast_forward && !o.ts.period && !o.ck.path
+        && !o.restore_path && !o.epochs_path && !o.generate && !o.classify_misses && !o.heat_map_prefix
+        && !o.perf && !o.perf_paths;
+}
+
+// Open the store and look this run up. Returns -1 if the store cannot be
+// opened, 1 with the result in *stored if this exact run was done before,
+// else 0.
+static int memo_lookup(Memo *memo, const char *dir, const sim_config_t &config, sim_stats_t *stored) {
+    std::string error;
+    if (!memo->results.open(dir, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return -1;
+    }
+    memo->hashed = memo->results.lookup_file(STDIN_FILENO, &memo->trace_hash);
+    if (!memo->hashed && hash_trace_file(STDIN_FILENO, &memo->trace_hash)) {
+        // a file can be read twice, and hashing is far cheaper than
+        // simulating: hash it up front so a stored result is found
+        memo->results.store_file(STDIN_FILENO, memo->trace_hash);
+        memo->hashed = true;
+    }
+    if (memo->hashed && memo->results.lookup(memo->trace_hash, config, stored)) {
+        fprintf(stderr, "%s: stored result for trace %s\n", dir, trace_hash_str(memo->trace_hash).c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// Store the result of a run memo_lookup() did not find
+static void memo_store(Memo *memo, const char *dir, const sim_config_t &config, const sim_stats_t *stats) {
+    if (!memo->hashed) {
+        memo->trace_hash = memo->hasher.digest();
+        memo->results.store_file(STDIN_FILENO, memo->trace_hash);
+    }
+    if (!memo->results.store(memo->trace_hash, config, stats)) {
+        fprintf(stderr, "%s: cannot store the result\n", dir);
+    }
+}
+
+int main(int argc, char **argv) {
+    Options o = Options();
+    int status = parse_options(argc, argv, &o);
+    if (status >= 0) {
+        return status;
+    }
+    if (o.parse_only) {
+        return parse_only();
+    }
+    if (o.no_huge_pages) {
+        arena_set_huge_pages(false);
+    }
+    PhaseProfiler profiler;
+    if (o.perf) {
+        profiler.enable();
+    }
+    std::unique_ptr<PathProfile> paths;
+    if (o.perf_paths) {
+        paths.reset(new PathProfile());
+        path_profile = paths.get();
+    }
+
+    // the machine-readable formats print nothing but the result
+    bool text = o.out.format == STATS_FORMAT_TEXT;
+    if (text) {
+        printf("Cache Settings\n");
+        printf("--------------\n");
+        print_cache_config(&o.config.l1_config, "L1");
+        print_cache_config(&o.config.l2_config, "L2");
+        printf("\n");
+    }
+    if (check_options(&o)) {
+        return 1;
+    }
+    sim_config_t &config = o.config;
+    TimeSampling &ts = o.ts;
+    Checkpointing &ck = o.ck;
+    Epochs ep;
+    ep.length = o.epoch_length;
+
+    /* Reuse a stored result if this exact run has been done before */
+    Memo memo;
+    memo.hashed = false;
+    bool memoize = memoizable(o);
+    if (memoize) {
+        sim_stats_t stored;
+        int found = memo_lookup(&memo, o.results_dir, config, &stored);
+        if (found) {
+            return found < 0 ? 1 : output_result(o.out, config, &stored);
+        }
+    }
 
     /* Setup the cache */
     sim_setup(&config);
+    if (o.sample_one_in > 1) {
+        sim_sample_sets(o.sample_one_in);
+    }
 
     /* Setup statistics */
     sim_stats_t stats;
     memset(&stats, 0, sizeof stats);
 
-    /* Begin reading the file */
-    char rw;
-    uint64_t address;
-    
-    while (!feof(stdin)) {
-        int ret = fscanf(stdin, "%c 0x%" PRIx64 "\n", &rw, &address);
-        if(ret == 2) {
-            sim_access(rw, address, &stats);
+    if (o.restore_path) {
+        uint64_t offset;
+        checkpoint_restore_t restored = sim_checkpoint_restore(o.restore_path, &offset, &stats);
+        if (restored == CHECKPOINT_FAILED) {
+            return 1;
+        }
+        fprintf(stderr, "%s: resuming at reference %" PRIu64 "%s\n", o.restore_path, offset,
+                restored == CHECKPOINT_L1_ONLY ? " with a warm L1 only (different L2 configuration)" : "");
+        // replay the schedule up to the checkpoint without simulating
+        simulate(&ts, NULL, offset, NULL);
+        ck.skip = offset;
+    }
+    ck.next = ts.pos + ck.every;
+    if (o.epochs_path) {
+        std::string error;
+        if (!ep.series.open(o.epochs_path, config, ep.length, stats, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        // epochs stay aligned when resuming from a checkpoint
+        ep.next = (ts.pos / ep.length + 1) * ep.length;
+    }
+
+    const uint64_t *recs;
+    size_t n;
+    int failed = 0;
+    // Simulate one batch; --perf times input and simulation separately
+    auto feed = [&](const uint64_t *batch, size_t len) {
+        if (memoize && !memo.hashed) {
+            memo.hasher.update(batch, len);
+        }
+        profiler.begin(PERF_PHASE_SIMULATE);
+        failed = run_batch(&ts, &ck, o.epochs_path ? &ep : NULL, batch, len, &stats);
+        profiler.end(len);
+    };
+    if (o.generate) {
+        /* Generate the trace in-process, no file involved */
+        TraceGenerator gen(o.gen_spec);
+        std::vector<uint64_t> batch(TRACE_BATCH);
+        while (!failed) {
+            profiler.begin(PERF_PHASE_READ);
+            n = gen.next(batch.data(), batch.size());
+            profiler.end(n);
+            if (!n) {
+                break;
+            }
+            feed(batch.data(), n);
+        }
+    } else {
+        /* Begin reading the file */
+        trace_reader_t reader;
+        if (trace_reader_open(&reader, STDIN_FILENO)) {
+            fprintf(stderr, "%s\n", trace_reader_strerror(&reader));
+            return 1;
+        }
+
+        if (o.pipelined) {
+            /* Decode on a second thread, simulate on this one */
+            TracePipeline pipeline(&reader);
+            while (!failed) {
+                profiler.begin(PERF_PHASE_READ);
+                recs = pipeline.next(&n);
+                profiler.end(recs ? n : 0);
+                if (!recs) {
+                    break;
+                }
+                feed(recs, n);
+            }
+            pipeline.finish();
+            print_pipeline_stats(pipeline.stats());
+        } else {
+            while (!failed) {
+                profiler.begin(PERF_PHASE_READ);
+                recs = trace_reader_next(&reader, &n);
+                profiler.end(recs ? n : 0);
+                if (!recs) {
+                    break;
+                }
+                feed(recs, n);
+            }
+        }
+        if (reader.error) {
+            fprintf(stderr, "%s\n", trace_reader_strerror(&reader));
+            trace_reader_close(&reader);
+            return 1;
+        }
+        trace_reader_close(&reader);
+    }
+    if (failed) {
+        return 1;
+    }
+    if (ck.skip) {
+        fprintf(stderr, "%s: the trace ends before the checkpoint's position\n", o.restore_path);
+        return 1;
+    }
+    if (ck.path && sim_checkpoint_save(ck.path, ts.pos, &stats)) {
+        return 1;
+    }
+    if (o.epochs_path) {
+        // the last epoch may be short
+        if (ts.pos + ep.length > ep.next) {
+            ep.series.record(ts.pos, stats);
+        }
+        std::string error;
+        if (!ep.series.close(&error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
         }
     }
 
+    if (ts.in_window) {
+        // the trace ended inside a window
+        sim_window_end(&stats);
+    }
+    profiler.begin(PERF_PHASE_FINISH);
     sim_finish(&stats);
+    profiler.end();
+    // stderr, like the pipeline report: stdout stays the plain result
+    profiler.report(stderr);
+    if (path_profile) {
+        path_profile->report(stderr, !config.l2_config.disabled);
+    }
+
+    if (memoize) {
+        memo_store(&memo, o.results_dir, config, &stats);
+    }
+
+    if (output_result(o.out, config, &stats)) {
+        return 1;
+    }
+    if (text && o.sample_one_in > 1) {
+        print_sample_stats(&stats);
+    }
+    if (text && (ts.fast_forward || ts.period)) {
+        print_time_sampling_stats(ts, !config.l2_config.disabled);
+    }
+    if (text && o.classify_misses) {
+        print_miss_classes(!config.l2_config.disabled);
+    }
+    if (o.heat_map_prefix && sim_instrument_dump(o.heat_map_prefix)) {
+        return 1;
+    }
 
-    print_statistics(&stats);
+    return 0;
+}
 
+// Print the result, or append it to the shared output file
+static int output_result(const Output &out, const sim_config_t &config, sim_stats_t *stats) {
+    if (out.append_path) {
+        if (stats_append(out.append_path, out.format, out.label, config, *stats)) {
+            perror(out.append_path);
+            return 1;
+        }
+    } else if (out.format == STATS_FORMAT_TEXT) {
+        print_statistics(stats);
+    } else {
+        std::string result = stats_format(out.format, out.label, config, *stats, true);
+        fwrite(result.data(), 1, result.size(), stdout);
+    }
     return 0;
 }
 
+// Feed one input batch to the simulator, dropping the records a restored
+// checkpoint covers, split at epoch ends, and write a checkpoint when one is
+// due
+static int run_batch(TimeSampling *ts, Checkpointing *ck, Epochs *ep, const uint64_t *recs, size_t n,
+                     sim_stats_t *stats) {
+    size_t drop = (size_t)std::min<uint64_t>(ck->skip, n);
+    ck->skip -= drop;
+    recs += drop;
+    n -= drop;
+    if (!ep) {
+        simulate(ts, recs, n, stats);
+    }
+    while (ep && n) {
+        size_t len = (size_t)std::min<uint64_t>(ep->next - ts->pos, n);
+        simulate(ts, recs, len, stats);
+        recs += len;
+        n -= len;
+        if (ts->pos == ep->next) {
+            ep->series.record(ts->pos, *stats);
+            ep->next += ep->length;
+        }
+    }
+    if (ck->every && ts->pos >= ck->next) {
+        ck->next = ts->pos + ck->every;
+        return sim_checkpoint_save(ck->path, ts->pos, stats);
+    }
+    return 0;
+}
+
+// Feed one batch through the time sampling schedule. With recs == NULL,
+// only advance the schedule by n references (used when resuming).
+static void simulate(TimeSampling *ts, const uint64_t *recs, size_t n, sim_stats_t *stats) {
+    if (!ts->fast_forward && !ts->period) {
+        if (recs) {
+            access_batch(recs, n, stats);
+        }
+        ts->pos += n;
+        return;
+    }
+    while (n) {
+        enum { SKIP, WARM, MEASURE } phase;
+        uint64_t len;
+        uint64_t off = 0;
+        if (ts->pos < ts->fast_forward) {
+            phase = WARM;
+            len = ts->fast_forward - ts->pos;
+        } else if (!ts->period) {
+            phase = MEASURE;
+            len = n;
+        } else {
+            uint64_t gap = ts->period - ts->window;
+            off = (ts->pos - ts->fast_forward) % ts->period;
+            if (off < gap - ts->warmup) {
+                phase = SKIP;
+                len = gap - ts->warmup - off;
+            } else if (off < gap) {
+                phase = WARM;
+                len = gap - off;
+            } else {
+                phase = MEASURE;
+                len = ts->period - off;
+                if (!ts->in_window) {
+                    if (recs) {
+                        sim_window_begin(stats);
+                    }
+                    ts->in_window = true;
+                }
+            }
+        }
+        if (len > n) {
+            len = n;
+        }
+
+        if (phase == SKIP) {
+            ts->skipped += len;
+        } else if (phase == WARM) {
+            if (recs) {
+                sim_warm_batch(recs, len);
+            }
+            ts->warmed += len;
+        } else {
+            if (recs) {
+                access_batch(recs, len, stats);
+            }
+            if (ts->period && off + len == ts->period) {
+                if (recs) {
+                    sim_window_end(stats);
+                }
+                ts->in_window = false;
+            }
+        }
+        if (recs) {
+            recs += len;
+        }
+        n -= len;
+        ts->pos += len;
+    }
+}
+
+static int parse_only(void) {
+    // opening already decodes the first block, so time it too
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, STDIN_FILENO)) {
+        fprintf(stderr, "%s\n", trace_reader_strerror(&reader));
+        return 1;
+    }
+
+    const uint64_t *recs;
+    size_t n;
+    uint64_t records = 0;
+    uint64_t writes = 0;
+    while ((recs = trace_reader_next(&reader, &n))) {
+        records += n;
+        // touch every record so the parse can't be skipped
+        for (size_t i = 0; i < n; i++) {
+            writes += recs[i] >> 63;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (reader.error) {
+        fprintf(stderr, "%s\n", trace_reader_strerror(&reader));
+        trace_reader_close(&reader);
+        return 1;
+    }
+
+    double secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Trace format: %s\n", !reader.binary ? "text" : (reader.flags & TRACE_FLAG_DELTA) ? "binary (delta)" : "binary (raw)");
+    if (!reader.binary) {
+        printf("Text parser: %s\n", trace_parse_text_impl());
+    }
+    printf("Records: %" PRIu64 " (%" PRIu64 " reads, %" PRIu64 " writes)\n", records, records - writes, writes);
+    printf("Bytes: %" PRIu64 "\n", reader.bytes_in);
+    printf("Time: %.3f s\n", secs);
+    printf("Throughput: %.3f GB/s, %.1f M records/s\n",
+           secs > 0 ? reader.bytes_in / secs / 1e9 : 0.0,
+           secs > 0 ? records / secs / 1e6 : 0.0);
+    if (reader.codec != TRACE_CODEC_NONE) {
+        // decompression runs inside the parse loop; split it out
+        double parse_secs = secs - reader.decompress_secs;
+        printf("Compression: %s, %" PRIu64 " bytes in (%.2fx)\n", trace_codec_name(reader.codec),
+               reader.bytes_compressed,
+               reader.bytes_compressed ? (double)reader.bytes_in / reader.bytes_compressed : 0.0);
+        printf("Decompress: %.3f s, %.3f GB/s out\n", reader.decompress_secs,
+               reader.decompress_secs > 0 ? reader.bytes_in / reader.decompress_secs / 1e9 : 0.0);
+        printf("Parse: %.3f s, %.3f GB/s\n", parse_secs,
+               parse_secs > 0 ? reader.bytes_in / parse_secs / 1e9 : 0.0);
+    }
+    trace_reader_close(&reader);
+    return 0;
+}
+
+// Content hash of the trace in the regular file behind fd. The reader maps
+// such a file instead of reading it, so the simulation can still read it
+// from the start. False for anything else (reading a pipe would consume
+// it) or an unreadable trace, which the simulation then reports.
+static bool hash_trace_file(int fd, TraceHash *hash) {
+    trace_mapping_t probe;
+    if (trace_map_fd(fd, &probe)) {
+        return false;
+    }
+    trace_unmap(&probe);
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, fd)) {
+        return false;
+    }
+    TraceHasher hasher;
+    const uint64_t *recs;
+    size_t n;
+    while ((recs = trace_reader_next(&reader, &n))) {
+        hasher.update(recs, n);
+    }
+    bool ok = reader.mapped && !reader.error;
+    trace_reader_close(&reader);
+    if (ok) {
+        *hash = hasher.digest();
+    }
+    return ok;
+}
+
+// Goes to stderr so stdout stays identical to a serial run
+static void print_pipeline_stats(const PipelineStats &ps) {
+    double decode_rate = ps.decode_secs > 0 ? ps.records / ps.decode_secs / 1e6 : 0.0;
+    double sim_rate = ps.consume_secs > 0 ? ps.records / ps.consume_secs / 1e6 : 0.0;
+    fprintf(stderr, "Pipeline: %" PRIu64 " records in %" PRIu64 " batches, %" PRIu64 " bytes\n",
+            ps.records, ps.batches, ps.bytes_in);
+    fprintf(stderr, "  decode:   %.3f s busy, %.3f s waiting on a full ring, %.1f M records/s\n",
+            ps.decode_secs, ps.producer_wait_secs, decode_rate);
+    if (ps.bytes_compressed) {
+        fprintf(stderr, "    of which decompress: %.3f s for %" PRIu64 " compressed bytes, %.3f GB/s out\n",
+                ps.decompress_secs, ps.bytes_compressed,
+                ps.decompress_secs > 0 ? ps.bytes_in / ps.decompress_secs / 1e9 : 0.0);
+    }
+    fprintf(stderr, "  simulate: %.3f s busy, %.3f s waiting on an empty ring, %.1f M records/s\n",
+            ps.consume_secs, ps.consumer_wait_secs, sim_rate);
+    fprintf(stderr, "  bottleneck: %s\n", decode_rate < sim_rate ? "decode" : "simulate");
+}
+
 static int parse_replace_policy(const char *arg, replacement_policy_t *policy_out) {
     if (!strcmp(arg, "mip") || !strcmp(arg, "MIP")) {
         *policy_out = REPLACEMENT_POLICY_MIP;
@@ -127,7 +834,44 @@ static int parse_prefetch_algo(const char *arg, prefetch_algo_t *pf_out) {
 }
 static void print_help(void) {
     printf("cachesim [OPTIONS] < traces/file.trace\n");
+    printf("Binary traces from cachesim-convert and gzip/xz/zstd-compressed traces are also accepted on stdin\n");
     printf("-h\t\tThis helpful output\n");
+    printf("-p\t\tOnly parse the trace and report parser throughput\n");
+    printf("-t\t\tDecode the trace on a second thread, report per-stage throughput\n");
+    printf("-g SPEC\t\tSimulate a synthetic trace generated in-process instead of reading stdin\n");
+    printf("      \t\t(see cachesim-gen -h for SPEC)\n");
+    printf("-k N\t\tSimulate only about 1 in N L2 sets (L1 sets with -D) and extrapolate\n");
+    printf("-m DIR\t\tResult store: reuse the stored result of an identical run, or store this one\n");
+    printf("-x FILE\t\tWrite a checkpoint of the simulator state to FILE at the end\n");
+    printf("-X N\t\tAlso write it every N references\n");
+    printf("-R FILE\t\tResume from a checkpoint, skipping the references it covers\n");
+    printf("--no-huge-pages\tKeep the cache and Markov state on small pages (by default state\n");
+    printf("        \tof 2 MB or more asks for huge pages)\n");
+    printf("Output:\n");
+    printf("  --format=F\tPrint the configuration and every statistic as json, csv or bin\n");
+    printf("            \t(default text)\n");
+    printf("  --append=FILE\tAppend the result to FILE instead (default format csv); safe\n");
+    printf("            \tfrom many concurrent runs\n");
+    printf("  --label=NAME\tTag the result with NAME, e.g. the trace\n");
+    printf("  -E FILE\tWrite per-epoch statistics to FILE (binary if it ends in .bin,\n");
+    printf("         \telse CSV)\n");
+    printf("  -e N\t\tReferences per epoch (default 100000)\n");
+    printf("Profiling (reports go to stderr):\n");
+    printf("  --perf\tHost cycles, instructions, LLC and branch misses per phase (trace\n");
+    printf("        \tinput, simulation, sim_finish); rdtsc timing where perf_event_open\n");
+    printf("        \tis not allowed\n");
+    printf("  --perf-paths\tTime every access and break the time out by path (L1 hit,\n");
+    printf("        \tL2 hit, L2 miss, prefetch, write-back); slows the simulation\n");
+    printf("Instrumentation (make INSTRUMENT=1):\n");
+    printf("  -M\t\tClassify misses as compulsory, capacity or conflict\n");
+    printf("  -H PREFIX\tWrite per-set and per-frame heat maps to PREFIX_l1_*.csv,\n");
+    printf("           \tPREFIX_l2_*.csv\n");
+    printf("Time sampling:\n");
+    printf("  -f N\t\tFast-forward: only warm the caches for the first N references\n");
+    printf("  -i P\t\tThen measure one window every P references\n");
+    printf("  -w U\t\tReferences per measurement window (default 10000)\n");
+    printf("  -W N\t\tWarm the caches for N references before each window, skip the\n");
+    printf("      \t\trest of the period (default: warm all of it)\n");
     printf("L1 parameters:\n");
     printf("  -c C1\t\tTotal size for L1 in bytes is 2^C1\n");
     printf("  -b B1\t\tSize of each block for L1 in bytes is 2^B1\n");
@@ -239,3 +983,72 @@ static void print_statistics(sim_stats_t* stats) {
     printf("L2 prefetch hits: %" PRIu64 "\n", stats->prefetch_hits_l2);
     printf("L2 prefetch misses: %" PRIu64 "\n", stats->prefetch_misses_l2);
 }
+
+static void print_estimate(const char *name, sim_estimate_t est) {
+    if (isnan(est.ci95)) {
+        printf("%s: %.3f (too few samples for an interval)\n", name, est.mean);
+    } else {
+        printf("%s: %.3f +/- %.3f (95%% CI)\n", name, est.mean, est.ci95);
+    }
+}
+
+static void print_sample_stats(const sim_stats_t *stats) {
+    sim_sample_stats_t sample;
+    sim_sample_report(stats, &sample);
+    printf("\n");
+    printf("Set Sampling\n");
+    printf("------------\n");
+    printf("L%u sets simulated: %" PRIu64 " of %" PRIu64 " (%u buckets)\n",
+           sample.level, sample.sampled_sets, sample.sets, sample.buckets);
+    printf("L%u %s simulated: %" PRIu64 " of %" PRIu64 "\n", sample.level,
+           sample.level == 1 ? "accesses" : "reads", sample.simulated, sample.total);
+    print_estimate("L1 hit ratio", sample.hit_ratio_l1);
+    if (sample.level == 2) {
+        print_estimate("L2 read hit ratio", sample.read_hit_ratio_l2);
+    }
+    print_estimate("L1 average access time (AAT)", sample.avg_access_time_l1);
+}
+
+static void print_time_sampling_stats(const TimeSampling &ts, bool l2_enabled) {
+    sim_window_stats_t win;
+    sim_window_report(&win);
+    printf("\n");
+    printf("Time Sampling\n");
+    printf("-------------\n");
+    printf("References: %" PRIu64 " measured, %" PRIu64 " warmed, %" PRIu64 " skipped\n",
+           ts.pos - ts.warmed - ts.skipped, ts.warmed, ts.skipped);
+    if (!ts.period) {
+        return;
+    }
+    printf("Measurement windows: %" PRIu64 " of %" PRIu64 " references\n", win.windows, ts.window);
+    print_estimate("L1 hit ratio", win.hit_ratio_l1);
+    if (l2_enabled) {
+        print_estimate("L2 read hit ratio", win.read_hit_ratio_l2);
+    }
+    print_estimate("L1 average access time (AAT)", win.avg_access_time_l1);
+    if (win.windows_for_3pct) {
+        printf("Windows for +/-3%% AAT: %" PRIu64 "\n", win.windows_for_3pct);
+    }
+}
+
+static void print_miss_class_line(const char *name, const sim_miss_classes_t &m) {
+    uint64_t total = m.compulsory + m.capacity + m.conflict;
+    double scale = total ? 100.0 / total : 0.0;
+    printf("%s: %" PRIu64 " compulsory (%.1f%%), %" PRIu64 " capacity (%.1f%%), %" PRIu64 " conflict (%.1f%%)\n",
+           name, m.compulsory, m.compulsory * scale, m.capacity, m.capacity * scale, m.conflict, m.conflict * scale);
+}
+
+// Conflict misses go away with more ways, capacity misses with more size
+static void print_miss_classes(bool l2_enabled) {
+    sim_instrument_stats_t instr;
+    if (sim_instrument_report(&instr)) {
+        return;
+    }
+    printf("\n");
+    printf("Miss Classification\n");
+    printf("-------------------\n");
+    print_miss_class_line("L1 misses", instr.l1);
+    if (l2_enabled) {
+        print_miss_class_line("L2 read misses", instr.l2);
+    }
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+#include "trace.hpp"
+#include "trace_gen.hpp"
+
+static void print_help(void);
+
+// Records generated per round
+static const size_t GEN_BATCH = 1 << 16;
+
+// Long options only; their codes sit above every short option
+enum {
+    OPT_FORMAT = 256,
+};
+static const struct option LONG_OPTIONS[] = {
+    {"format", required_argument, NULL, OPT_FORMAT},
+    {NULL, 0, NULL, 0},
+};
+
+// "R 0x...\n" lines, formatted by hand: printf would be the bottleneck
+static int write_text(FILE *out, const uint64_t *recs, size_t n, std::vector<char> &buf) {
+    static const char HEX[] = "0123456789abcdef";
+    buf.resize(n * 21);
+    char *p = buf.data();
+    for (size_t i = 0; i < n; i++) {
+        uint64_t addr = trace_addr(recs[i]);
+        *p++ = trace_rw(recs[i]);
+        *p++ = ' ';
+        *p++ = '0';
+        *p++ = 'x';
+        int digits = 1;
+        while (digits < 16 && (addr >> (4 * digits))) {
+            digits++;
+        }
+        for (int d = digits - 1; d >= 0; d--) {
+            *p++ = HEX[(addr >> (4 * d)) & 15];
+        }
+        *p++ = '\n';
+    }
+    size_t len = p - buf.data();
+    return fwrite(buf.data(), 1, len, out) != len;
+}
+
+int main(int argc, char **argv) {
+    const char *format = "raw";
+    const char *out_path = NULL;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt_long(argc, argv, "o:h", LONG_OPTIONS, NULL))) {
+        switch(opt) {
+        case OPT_FORMAT:
+            format = optarg;
+            break;
+        case 'o':
+            out_path = optarg;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+    if (argc - optind != 1) {
+        print_help();
+        return 1;
+    }
+    bool text = !strcmp(format, "text");
+    if (!text && strcmp(format, "raw") && strcmp(format, "delta")) {
+        fprintf(stderr, "Unknown format '%s'\n", format);
+        return 1;
+    }
+
+    TraceGenSpec spec;
+    std::string error;
+    if (!trace_gen_parse(argv[optind], &spec, &error)) {
+        fprintf(stderr, "%s: %s\n", argv[optind], error.c_str());
+        return 1;
+    }
+
+    FILE *out = out_path ? fopen(out_path, "wb") : stdout;
+    if (!out) {
+        perror(out_path);
+        return 1;
+    }
+    const char *out_name = out_path ? out_path : "stdout";
+    trace_writer_t writer;
+    if (!text && trace_writer_open_counted(&writer, out, !strcmp(format, "delta") ? TRACE_FLAG_DELTA : 0, spec.n)) {
+        fprintf(stderr, "%s: cannot write header\n", out_name);
+        return 1;
+    }
+
+    TraceGenerator gen(spec);
+    std::vector<uint64_t> recs(GEN_BATCH);
+    std::vector<char> text_buf;
+    size_t n;
+    int failed = 0;
+    while (!failed && (n = gen.next(recs.data(), recs.size()))) {
+        failed = text ? write_text(out, recs.data(), n, text_buf)
+                      : trace_writer_append_packed(&writer, recs.data(), n);
+    }
+    if (!text) {
+        failed |= trace_writer_close(&writer);
+    }
+    if (fflush(out) || failed || (out_path && fclose(out))) {
+        fprintf(stderr, "%s: write failed\n", out_name);
+        return 1;
+    }
+    return 0;
+}
+
+static void print_help(void) {
+    printf("cachesim-gen [OPTIONS] SPEC\n");
+    printf("Writes a deterministic synthetic trace; SPEC is KIND[:key=value,...]\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-o FILE\t\tOutput file (default stdout; pipes work for every format)\n");
+    printf("--format=F\tOutput format: raw (default) or delta binary, or text\n");
+    printf("Kinds:\n");
+    printf("  strided\tbase + i * stride, wrapping at footprint\n");
+    printf("  uniform\t8-byte words drawn uniformly from footprint\n");
+    printf("  zipf\t\t64-byte blocks of footprint with Zipf(theta) popularity\n");
+    printf("  chase\t\tpointer chasing around one random cycle of node-byte nodes\n");
+    printf("  matmul\tC = A * B, dim x dim 8-byte elements, tile x tile blocks (0: naive)\n");
+    printf("Settings (K, M, G suffixes multiply by 2^10, 2^20, 2^30):\n");
+    printf("  n=N\t\tRecords (default 1M)\n");
+    printf("  seed=S\t\tRandom seed (default 1)\n");
+    printf("  writes=F\tFraction of writes, except matmul (default 0.3)\n");
+    printf("  base=A\t\tLowest address (default 0x10000000)\n");
+    printf("  footprint=B\tBytes touched (default 1M)\n");
+    printf("  stride=B\tstrided: bytes between references (default 64)\n");
+    printf("  theta=T\tzipf: skew (default 0.99)\n");
+    printf("  node=B\t\tchase: node size (default 64)\n");
+    printf("  dim=N, tile=T\tmatmul: matrix and tile size (default 256, 0)\n");
+}
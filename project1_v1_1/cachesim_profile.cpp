@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "cachesim.hpp"
+#include "stack_distance.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+// Block sizes validate_config accepts for the swept caches
+static const uint64_t PROFILE_B[] = {5, 6, 7};
+static const size_t PROFILE_N_B = sizeof PROFILE_B / sizeof *PROFILE_B;
+
+// Reuse distances of one trace at one block size. hist[d] counts the
+// references at LRU stack distance d, so a fully associative LRU cache of
+// N blocks misses on the cold references plus every one with d >= N.
+struct BlockProfile {
+    uint64_t b;
+    StackDistance sd;
+    std::vector<uint64_t> hist = std::vector<uint64_t>(64);
+    uint64_t cold = 0;
+    uint64_t last_block = UINT64_MAX;
+
+    // misses[n] for every n up to the largest distance seen plus one
+    std::vector<uint64_t> misses() const;
+};
+
+struct TraceProfile {
+    std::string path;
+    const char *name;
+    uint64_t accesses = 0;
+    BlockProfile blocks[PROFILE_N_B];
+    std::string error;
+};
+
+static void print_help(void);
+static void profile_trace(TraceProfile *p);
+static void print_summary(const TraceProfile &p, double knee);
+static void write_mrc_csv(FILE *out, const TraceProfile &p, unsigned steps);
+static void write_hist_csv(FILE *out, const TraceProfile &p);
+
+int main(int argc, char **argv) {
+    unsigned n_threads = 0;
+    unsigned steps = 4;
+    double knee = 0.01;
+    const char *mrc_path = NULL;
+    const char *hist_path = NULL;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt(argc, argv, "j:m:d:n:k:h"))) {
+        switch(opt) {
+        case 'j':
+            n_threads = atoi(optarg);
+            break;
+        case 'm':
+            mrc_path = optarg;
+            break;
+        case 'd':
+            hist_path = optarg;
+            break;
+        case 'n':
+            steps = atoi(optarg);
+            break;
+        case 'k':
+            knee = atof(optarg);
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+    if (optind == argc || steps < 1 || steps > 64) {
+        print_help();
+        return 1;
+    }
+
+    // one streaming pass per trace, traces side by side
+    std::vector<TraceProfile> profiles(argc - optind);
+    ThreadPool pool(n_threads);
+    for (size_t i = 0; i < profiles.size(); i++) {
+        TraceProfile *p = &profiles[i];
+        p->path = argv[optind + i];
+        p->name = strrchr(argv[optind + i], '/') ? strrchr(argv[optind + i], '/') + 1 : argv[optind + i];
+        for (size_t j = 0; j < PROFILE_N_B; j++) {
+            p->blocks[j].b = PROFILE_B[j];
+        }
+        pool.submit([p] { profile_trace(p); });
+    }
+    pool.wait();
+
+    for (const TraceProfile &p : profiles) {
+        if (!p.error.empty()) {
+            fprintf(stderr, "%s: %s\n", p.path.c_str(), p.error.c_str());
+            return 1;
+        }
+    }
+
+    FILE *mrc = NULL, *hist = NULL;
+    if (mrc_path && !(mrc = fopen(mrc_path, "w"))) {
+        perror(mrc_path);
+        return 1;
+    }
+    if (hist_path && !(hist = fopen(hist_path, "w"))) {
+        perror(hist_path);
+        if (mrc) {
+            fclose(mrc);
+        }
+        return 1;
+    }
+    if (mrc) {
+        fprintf(mrc, "trace,B,blocks,bytes,misses,miss_ratio\n");
+    }
+    if (hist) {
+        fprintf(hist, "trace,B,distance_lo,distance_hi,references\n");
+    }
+    for (const TraceProfile &p : profiles) {
+        print_summary(p, knee);
+        if (mrc) {
+            write_mrc_csv(mrc, p, steps);
+        }
+        if (hist) {
+            write_hist_csv(hist, p);
+        }
+    }
+    if (mrc) {
+        fclose(mrc);
+    }
+    if (hist) {
+        fclose(hist);
+    }
+    return 0;
+}
+
+static void profile_trace(TraceProfile *p) {
+    int fd = open(p->path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        p->error = strerror(errno);
+        return;
+    }
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, fd)) {
+        p->error = trace_reader_strerror(&reader);
+        close(fd);
+        return;
+    }
+
+    const uint64_t *recs;
+    size_t n;
+    while ((recs = trace_reader_next(&reader, &n))) {
+        p->accesses += n;
+        for (BlockProfile &bp : p->blocks) {
+            for (size_t i = 0; i < n; i++) {
+                uint64_t block = trace_addr(recs[i]) >> bp.b;
+                // back-to-back references to the MRU block leave the stack
+                // as it is
+                if (block == bp.last_block) {
+                    bp.hist[0]++;
+                    continue;
+                }
+                bp.last_block = block;
+                uint64_t d = bp.sd.access(block);
+                if (d == StackDistance::COLD) {
+                    bp.cold++;
+                    continue;
+                }
+                if (d >= bp.hist.size()) {
+                    bp.hist.resize(std::max<uint64_t>(d + 1, 2 * bp.hist.size()));
+                }
+                bp.hist[d]++;
+            }
+        }
+    }
+    if (reader.error) {
+        p->error = trace_reader_strerror(&reader);
+    }
+    trace_reader_close(&reader);
+    close(fd);
+}
+
+std::vector<uint64_t> BlockProfile::misses() const {
+    size_t top = hist.size();
+    while (top > 0 && hist[top - 1] == 0) {
+        top--;
+    }
+    std::vector<uint64_t> out(top + 1);
+    out[top] = cold;
+    for (size_t n = top; n > 0; n--) {
+        out[n - 1] = out[n] + hist[n - 1];
+    }
+    return out;
+}
+
+static uint64_t ceil_log2(uint64_t x) {
+    uint64_t bits = 0;
+    while (bits < 63 && (1ULL << bits) < x) {
+        bits++;
+    }
+    return bits;
+}
+
+static double ratio(uint64_t num, uint64_t den) {
+    return den ? (double)num / den : 0.0;
+}
+
+static void print_summary(const TraceProfile &p, double knee) {
+    std::vector<uint64_t> misses[PROFILE_N_B];
+    uint64_t c_lo = UINT64_MAX, c_hi = 0;
+    for (size_t j = 0; j < PROFILE_N_B; j++) {
+        const BlockProfile &bp = p.blocks[j];
+        misses[j] = bp.misses();
+        c_lo = std::min(c_lo, bp.b);
+        c_hi = std::max(c_hi, bp.b + ceil_log2(misses[j].size() - 1));
+    }
+
+    printf("%s: %" PRIu64 " accesses\n", p.name, p.accesses);
+    printf("%3s %14s %14s %8s %8s %8s\n", "B", "blocks", "footprint", "cold MR", "fits C", "knee C");
+    for (size_t j = 0; j < PROFILE_N_B; j++) {
+        const BlockProfile &bp = p.blocks[j];
+        const std::vector<uint64_t> &m = misses[j];
+        // smallest cache (log2 bytes) holding every reuse, and the size
+        // past which no doubling saves `knee` of the accesses any more
+        uint64_t fits = bp.b + ceil_log2(m.size() - 1);
+        uint64_t knee_c = fits;
+        while (knee_c > bp.b) {
+            uint64_t n = 1ULL << (knee_c - 1 - bp.b);
+            uint64_t lo = std::min<uint64_t>(n, m.size() - 1);
+            uint64_t hi = std::min<uint64_t>(2 * n, m.size() - 1);
+            if (ratio(m[lo] - m[hi], p.accesses) >= knee) {
+                break;
+            }
+            knee_c--;
+        }
+        printf("%3" PRIu64 " %14" PRIu64 " %14" PRIu64 " %8.3f %8" PRIu64 " %8" PRIu64 "\n",
+               bp.b, bp.sd.distinct(), bp.sd.distinct() << bp.b, ratio(bp.cold, p.accesses), fits, knee_c);
+    }
+
+    printf("Fully associative LRU miss ratio\n");
+    printf("%3s", "C");
+    for (size_t j = 0; j < PROFILE_N_B; j++) {
+        printf("   B=%-3" PRIu64, p.blocks[j].b);
+    }
+    printf("\n");
+    for (uint64_t c = c_lo; c <= c_hi; c++) {
+        printf("%3" PRIu64, c);
+        for (size_t j = 0; j < PROFILE_N_B; j++) {
+            const BlockProfile &bp = p.blocks[j];
+            if (c < bp.b) {
+                printf("   %5s", "-");
+                continue;
+            }
+            uint64_t n = std::min<uint64_t>(1ULL << (c - bp.b), misses[j].size() - 1);
+            printf("   %5.3f", ratio(misses[j][n], p.accesses));
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+// `steps` points per doubling of capacity, from one block up to the size
+// that holds every reuse
+static void write_mrc_csv(FILE *out, const TraceProfile &p, unsigned steps) {
+    for (const BlockProfile &bp : p.blocks) {
+        std::vector<uint64_t> m = bp.misses();
+        uint64_t prev = 0;
+        for (uint64_t k = 0;; k++) {
+            uint64_t n = (uint64_t)llround(pow(2.0, (double)k / steps));
+            if (n == prev) {
+                continue;
+            }
+            prev = n;
+            uint64_t idx = std::min<uint64_t>(n, m.size() - 1);
+            fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f\n",
+                    p.name, bp.b, n, n << bp.b, m[idx], ratio(m[idx], p.accesses));
+            if (n >= m.size() - 1) {
+                break;
+            }
+        }
+    }
+}
+
+// Power-of-two distance buckets [lo, hi]; cold references get lo = hi = inf
+static void write_hist_csv(FILE *out, const TraceProfile &p) {
+    for (const BlockProfile &bp : p.blocks) {
+        uint64_t lo = 0;
+        while (lo < bp.hist.size()) {
+            uint64_t hi = lo ? 2 * lo - 1 : 0;
+            uint64_t refs = 0;
+            for (uint64_t d = lo; d <= hi && d < bp.hist.size(); d++) {
+                refs += bp.hist[d];
+            }
+            fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", p.name, bp.b, lo, hi, refs);
+            lo = hi + 1;
+        }
+        fprintf(out, "%s,%" PRIu64 ",inf,inf,%" PRIu64 "\n", p.name, bp.b, bp.cold);
+    }
+}
+
+static void print_help(void) {
+    printf("cachesim-profile [OPTIONS] <trace>...\n");
+    printf("Block reuse distances and fully associative LRU miss-ratio curves at B = 5, 6, 7,\n");
+    printf("from one pass over each trace\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-j N\t\tNumber of worker threads (default: one per hardware thread)\n");
+    printf("-m FILE\t\tWrite the full miss-ratio curves as CSV\n");
+    printf("-n N\t\tPoints per doubling of capacity in the curves (default 4)\n");
+    printf("-d FILE\t\tWrite the reuse-distance histograms (power-of-two buckets) as CSV\n");
+    printf("-k F\t\tKnee: the size past which no doubling saves F of the accesses (default 0.01)\n");
+}
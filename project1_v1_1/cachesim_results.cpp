@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+#include "cachesim.hpp"
+#include "result_cache.hpp"
+#include "trace.hpp"
+
+static const char *const PREFETCH_NAMES[] = {"none", "plus1", "markov", "hybrid"};
+static const size_t N_PREFETCH = sizeof PREFETCH_NAMES / sizeof *PREFETCH_NAMES;
+
+static void print_help(void);
+
+// Content hash of a trace file, memoized in the store like cachesim does
+static int hash_trace(ResultCache &results, const char *path, TraceHash *hash) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+    if (!results.lookup_file(fd, hash)) {
+        std::vector<uint64_t> recs;
+        if (trace_load(path, recs)) {
+            fprintf(stderr, "%s: cannot read trace\n", path);
+            close(fd);
+            return 1;
+        }
+        *hash = trace_hash(recs);
+        results.store_file(fd, *hash);
+    }
+    close(fd);
+    return 0;
+}
+
+static void print_record(const ResultRecord &rec) {
+    const uint64_t *l1 = rec.config;
+    const uint64_t *l2 = rec.config + SIM_CONFIG_WORDS / 2;
+    printf("%s  C1=%" PRIu64 " B=%" PRIu64 " S1=%" PRIu64, trace_hash_str(rec.trace).c_str(), l1[1], l1[2], l1[3]);
+    if (l2[0]) {
+        printf(" L2=off");
+    } else {
+        printf(" C2=%" PRIu64 " S2=%" PRIu64 " prefetch=%s r=%" PRIu64, l2[1], l2[3],
+               l2[6] < N_PREFETCH ? PREFETCH_NAMES[l2[6]] : "?", l2[7]);
+    }
+    printf("  AAT=%.3f\n", rec.stats.avg_access_time_l1);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = ".cachesim-results";
+    bool list = false, all = false, prune = false;
+    std::vector<const char *> trace_paths;
+    std::vector<uint64_t> prefetchers;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt(argc, argv, "d:lt:F:aph"))) {
+        switch(opt) {
+        case 'd':
+            dir = optarg;
+            break;
+        case 'l':
+            list = true;
+            break;
+        case 't':
+            trace_paths.push_back(optarg);
+            break;
+        case 'F': {
+            uint64_t i = 0;
+            while (i < N_PREFETCH && strcmp(optarg, PREFETCH_NAMES[i])) {
+                i++;
+            }
+            if (i == N_PREFETCH) {
+                fprintf(stderr, "Unknown prefetcher '%s'\n", optarg);
+                return 1;
+            }
+            prefetchers.push_back(i);
+            break;
+        }
+        case 'a':
+            all = true;
+            break;
+        case 'p':
+            prune = true;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+    if (optind != argc || !(list || all || prune || !trace_paths.empty() || !prefetchers.empty())) {
+        print_help();
+        return 1;
+    }
+
+    ResultCache results;
+    std::string error;
+    if (!results.open(dir, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    std::vector<TraceHash> traces;
+    for (const char *path : trace_paths) {
+        TraceHash hash;
+        if (hash_trace(results, path, &hash)) {
+            return 1;
+        }
+        traces.push_back(hash);
+    }
+
+    if (all || prune || !traces.empty() || !prefetchers.empty()) {
+        // a record goes if it matches any -t trace or any -F prefetcher
+        long dropped = results.invalidate([&](const ResultRecord &rec) {
+            if (all) {
+                return true;
+            }
+            for (const TraceHash &hash : traces) {
+                if (rec.trace == hash) {
+                    return true;
+                }
+            }
+            const uint64_t *l2 = rec.config + SIM_CONFIG_WORDS / 2;
+            for (uint64_t pf : prefetchers) {
+                if (!l2[0] && l2[6] == pf) {
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (dropped < 0) {
+            fprintf(stderr, "%s: cannot rewrite the results\n", dir);
+            return 1;
+        }
+        printf("%s: dropped %ld results\n", dir, dropped);
+    }
+
+    if (list) {
+        std::vector<ResultRecord> recs = results.records();
+        for (const ResultRecord &rec : recs) {
+            print_record(rec);
+        }
+        printf("%s: %zu results\n", dir, recs.size());
+    }
+    return 0;
+}
+
+static void print_help(void) {
+    printf("cachesim-results [OPTIONS]\n");
+    printf("Lists and invalidates the results stored by cachesim -m and cachesim-sweep -m\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-d DIR\t\tResult store (default .cachesim-results)\n");
+    printf("-l\t\tList the stored results\n");
+    printf("-t TRACE\tDrop every result for this trace (repeatable)\n");
+    printf("-F PF\t\tDrop every result using this L2 prefetcher (repeatable)\n");
+    printf("-a\t\tDrop everything\n");
+    printf("-p\t\tOnly compact: drop results from other simulator versions and superseded ones\n");
+}
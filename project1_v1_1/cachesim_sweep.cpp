@@ -0,0 +1,719 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cachesim.hpp"
+#include "cache_simulator.hpp"
+#include "stack_distance.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include "result_cache.hpp"
+
+// Sweep spec, one directive per line ('#' starts a comment):
+//
+//   trace <name> <path>
+//   sweep <output.csv> prefetch=<algos> C1=<vals> B=<vals> S1=<vals> C2=<vals> S2=<vals> r=<vals>
+//
+// <vals> is a comma separated list of numbers and lo-hi ranges ("14,15",
+// "0-4"), <algos> a list of none/plus1/markov/hybrid. Every sweep runs over
+// every trace; combinations cachesim would reject are skipped, exactly like
+// search.sh does. See search.sweep.
+//
+//   l1grid <output.csv> C1=<vals> B=<vals> S1=<vals>
+//
+// L1-only (L2 disabled) hit/miss counts and AAT for a whole (C1, B, S1)
+// grid from a single pass over each trace, using LRU stack distances: for
+// a fixed B and set count, a reference hits in a 2^S1-way L1 exactly when
+// its per-set stack distance is below 2^S1.
+//
+//   search <output.csv> budget=<bytes> eta=<n> rungs=<n> <sweep keys...>
+//
+// Successive halving instead of the whole grid: every legal point within
+// the storage budget (data plus metadata, see storage_bytes()) runs on a
+// 1/eta^(rungs-1) prefix of each trace, then the best 1/eta of them (by
+// non-dominated sorting on storage and L1 AAT, so cheap configurations
+// survive next to fast ones) continue to a prefix eta times longer, until
+// the survivors have seen the whole trace. Survivors keep their simulator
+// between rungs, so no access is simulated twice. The output holds the
+// survivors with their storage and whether they are on the Pareto
+// frontier. Defaults: eta=3, rungs=4, no budget.
+
+struct SweepTrace {
+    std::string name;
+    std::string path;
+    std::vector<uint64_t> recs;
+    TraceHash hash;
+};
+
+struct Sweep {
+    bool l1_grid;
+    bool search;
+    uint64_t budget;
+    uint64_t eta;
+    uint64_t rungs;
+    std::string output;
+    std::vector<uint64_t> prefetch;
+    std::vector<uint64_t> c1, b, s1, c2, s2, r;
+};
+
+struct SweepPoint {
+    size_t trace;
+    sim_config_t config;
+    sim_stats_t stats;
+    // search only
+    uint64_t storage;
+    bool pareto;
+};
+
+static const char *const PREFETCH_NAMES[] = {"none", "plus1", "markov", "hybrid"};
+
+static const char *const L1_GRID_CSV_HEADER =
+    "trace,C1,B,S1,L1_accesses,L1_hits,L1_misses,L1_HR,L1_MR,L1_AAT";
+
+static const char *const CSV_HEADER =
+    "trace,C1,B,S1,C2,S2,prefetch,r,L1_AAT,L1_HR,L1_MR,L2_AAT,L2_RHR,L2_RMR,"
+    "PF_issued,PF_hits,PF_misses,L1_misses,L2_rhits,L2_rmisses,WB_L1";
+
+static const char *const SEARCH_CSV_HEADER =
+    "trace,C1,B,S1,C2,S2,prefetch,r,L1_AAT,L1_HR,L1_MR,L2_AAT,L2_RHR,L2_RMR,"
+    "PF_issued,PF_hits,PF_misses,L1_misses,L2_rhits,L2_rmisses,WB_L1,storage_bytes,pareto";
+
+static void print_help(void);
+static int parse_spec(const char *path, std::vector<SweepTrace> &traces, std::vector<Sweep> &sweeps);
+static std::vector<SweepPoint> expand_sweep(const Sweep &sweep, size_t n_traces);
+static void write_csv_row(FILE *out, const SweepTrace &trace, const SweepPoint &point);
+static void write_csv_fields(FILE *out, const SweepTrace &trace, const SweepPoint &point);
+static std::vector<SweepPoint> run_search(const Sweep &sweep, const std::vector<SweepTrace> &traces,
+                                          ThreadPool &pool, ResultCache *results);
+static void run_l1_grid(const std::vector<SweepPoint> &points, const SweepTrace &trace,
+                        std::vector<sim_stats_t *> &stats);
+static void write_l1_grid_csv_row(FILE *out, const SweepTrace &trace, const SweepPoint &point);
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+    unsigned n_threads = 0;
+    const char *results_dir = NULL;
+    int opt;
+
+    /* Read arguments */
+    while(-1 != (opt = getopt(argc, argv, "j:m:h"))) {
+        switch(opt) {
+        case 'j':
+            n_threads = atoi(optarg);
+            break;
+        case 'm':
+            results_dir = optarg;
+            break;
+        case 'h':
+            /* Fall through */
+        default:
+            print_help();
+            return 0;
+        }
+    }
+    if (argc - optind != 1) {
+        print_help();
+        return 1;
+    }
+
+    std::vector<SweepTrace> traces;
+    std::vector<Sweep> sweeps;
+    if (parse_spec(argv[optind], traces, sweeps)) {
+        return 1;
+    }
+
+    ResultCache results;
+    if (results_dir) {
+        std::string error;
+        if (!results.open(results_dir, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    ThreadPool pool(n_threads);
+    printf("Using %u threads\n", pool.size());
+
+    /* Every trace is parsed exactly once and shared by all of its runs */
+    double start = now();
+    std::vector<int> load_failed(traces.size(), 0);
+    // a trace file hashed by an earlier run is not hashed again; the
+    // descriptors identify the files to the store (ResultCache::store_file)
+    std::vector<int> fds(traces.size(), -1);
+    std::vector<char> hashed(traces.size(), 0);
+    if (results_dir) {
+        for (size_t i = 0; i < traces.size(); i++) {
+            fds[i] = open(traces[i].path.c_str(), O_RDONLY);
+            hashed[i] = fds[i] >= 0 && results.lookup_file(fds[i], &traces[i].hash);
+        }
+    }
+    for (size_t i = 0; i < traces.size(); i++) {
+        pool.submit([&traces, &load_failed, &hashed, i, results_dir] {
+            load_failed[i] = trace_load(traces[i].path.c_str(), traces[i].recs);
+            if (results_dir && !load_failed[i] && !hashed[i]) {
+                traces[i].hash = trace_hash(traces[i].recs);
+            }
+        });
+    }
+    pool.wait();
+    for (size_t i = 0; i < traces.size(); i++) {
+        if (load_failed[i]) {
+            fprintf(stderr, "%s: cannot read trace\n", traces[i].path.c_str());
+            return 1;
+        }
+        if (fds[i] >= 0) {
+            // store_file() ignores anything but a regular file
+            if (!hashed[i]) {
+                results.store_file(fds[i], traces[i].hash);
+            }
+            close(fds[i]);
+        }
+        printf("Loaded %s: %zu accesses\n", traces[i].name.c_str(), traces[i].recs.size());
+    }
+    printf("Traces loaded in %.2f s\n", now() - start);
+
+    for (const Sweep &sweep : sweeps) {
+        FILE *out = fopen(sweep.output.c_str(), "w");
+        if (!out) {
+            perror(sweep.output.c_str());
+            return 1;
+        }
+
+        start = now();
+        std::vector<SweepPoint> points = expand_sweep(sweep, traces.size());
+        if (sweep.l1_grid) {
+            // one pass per trace covers all of that trace's points
+            for (size_t t = 0; t < traces.size(); t++) {
+                pool.submit([&points, &traces, t] {
+                    std::vector<SweepPoint> mine;
+                    std::vector<sim_stats_t *> stats;
+                    for (SweepPoint &point : points) {
+                        if (point.trace == t) {
+                            mine.push_back(point);
+                            stats.push_back(&point.stats);
+                        }
+                    }
+                    run_l1_grid(mine, traces[t], stats);
+                });
+            }
+        } else if (sweep.search) {
+            points = run_search(sweep, traces, pool, results_dir ? &results : NULL);
+        } else {
+            // points with a stored result are not simulated again
+            std::vector<bool> stored(points.size(), false);
+            size_t n_stored = 0;
+            if (results_dir) {
+                for (size_t i = 0; i < points.size(); i++) {
+                    stored[i] = results.lookup(traces[points[i].trace].hash, points[i].config, &points[i].stats);
+                    n_stored += stored[i];
+                }
+                printf("%s: %zu of %zu results already stored\n", sweep.output.c_str(), n_stored, points.size());
+            }
+            for (size_t i = 0; i < points.size(); i++) {
+                if (stored[i]) {
+                    continue;
+                }
+                SweepPoint *p = &points[i];
+                const std::vector<uint64_t> *recs = &traces[p->trace].recs;
+                pool.submit([p, recs] {
+                    // one arena per worker, reset and reused point after point
+                    static thread_local Arena arena;
+                    CacheSimulator sim(p->config, true, &arena);
+                    memset(&p->stats, 0, sizeof p->stats);
+                    sim.access_batch(recs->data(), recs->size(), &p->stats);
+                    sim.finish(&p->stats);
+                });
+            }
+            pool.wait();
+            for (size_t i = 0; results_dir && i < points.size(); i++) {
+                if (!stored[i] && !results.store(traces[points[i].trace].hash, points[i].config, &points[i].stats)) {
+                    fprintf(stderr, "%s: cannot store results\n", results_dir);
+                    break;
+                }
+            }
+        }
+        pool.wait();
+
+        fprintf(out, "%s\n", sweep.l1_grid ? L1_GRID_CSV_HEADER : sweep.search ? SEARCH_CSV_HEADER : CSV_HEADER);
+        for (const SweepPoint &point : points) {
+            if (sweep.l1_grid) {
+                write_l1_grid_csv_row(out, traces[point.trace], point);
+            } else if (sweep.search) {
+                write_csv_fields(out, traces[point.trace], point);
+                fprintf(out, ",%" PRIu64 ",%d\n", point.storage, point.pareto ? 1 : 0);
+            } else {
+                write_csv_row(out, traces[point.trace], point);
+            }
+        }
+        fclose(out);
+        printf("%s: %zu configurations in %.2f s\n", sweep.output.c_str(), points.size(), now() - start);
+    }
+
+    return 0;
+}
+
+static int parse_values(const char *arg, std::vector<uint64_t> &out, bool prefetch_names) {
+    out.clear();
+    std::string list(arg);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t comma = list.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = list.size();
+        }
+        std::string item = list.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        if (prefetch_names) {
+            uint64_t i = 0;
+            while (i < sizeof PREFETCH_NAMES / sizeof *PREFETCH_NAMES && item != PREFETCH_NAMES[i]) {
+                i++;
+            }
+            if (i == sizeof PREFETCH_NAMES / sizeof *PREFETCH_NAMES) {
+                return 1;
+            }
+            out.push_back(i);
+            continue;
+        }
+
+        char *end;
+        uint64_t lo = strtoull(item.c_str(), &end, 10);
+        uint64_t hi = lo;
+        if (end == item.c_str()) {
+            return 1;
+        }
+        if (*end == '-') {
+            const char *hi_str = end + 1;
+            hi = strtoull(hi_str, &end, 10);
+            if (end == hi_str) {
+                return 1;
+            }
+        }
+        if (*end || hi < lo) {
+            return 1;
+        }
+        for (uint64_t v = lo; v <= hi; v++) {
+            out.push_back(v);
+        }
+    }
+    return out.empty();
+}
+
+static int parse_spec(const char *path, std::vector<SweepTrace> &traces, std::vector<Sweep> &sweeps) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+    char line[4096];
+    int lineno = 0;
+    while (fgets(line, sizeof line, in)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+
+        std::vector<char *> words;
+        for (char *w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n")) {
+            words.push_back(w);
+        }
+        if (words.empty()) {
+            continue;
+        }
+
+        if (!strcmp(words[0], "trace") && words.size() == 3) {
+            SweepTrace trace;
+            trace.name = words[1];
+            trace.path = words[2];
+            traces.push_back(trace);
+        } else if ((!strcmp(words[0], "sweep") || !strcmp(words[0], "l1grid") || !strcmp(words[0], "search"))
+                   && words.size() >= 2) {
+            Sweep sweep;
+            sweep.l1_grid = !strcmp(words[0], "l1grid");
+            sweep.search = !strcmp(words[0], "search");
+            sweep.budget = UINT64_MAX;
+            sweep.eta = 3;
+            sweep.rungs = 4;
+            sweep.output = words[1];
+            sweep.prefetch.push_back(PREFETCH_NONE);
+            sweep.c1.push_back(DEFAULT_SIM_CONFIG.l1_config.c);
+            sweep.b.push_back(DEFAULT_SIM_CONFIG.l1_config.b);
+            sweep.s1.push_back(DEFAULT_SIM_CONFIG.l1_config.s);
+            sweep.c2.push_back(DEFAULT_SIM_CONFIG.l2_config.c);
+            sweep.s2.push_back(DEFAULT_SIM_CONFIG.l2_config.s);
+            sweep.r.push_back(0);
+
+            for (size_t i = 2; i < words.size(); i++) {
+                char *eq = strchr(words[i], '=');
+                std::vector<uint64_t> *dim = NULL;
+                std::vector<uint64_t> single;
+                uint64_t *setting = NULL;
+                if (eq) {
+                    *eq = '\0';
+                    const char *key = words[i];
+                    if (sweep.search && !strcmp(key, "budget")) setting = &sweep.budget;
+                    else if (sweep.search && !strcmp(key, "eta")) setting = &sweep.eta;
+                    else if (sweep.search && !strcmp(key, "rungs")) setting = &sweep.rungs;
+                    if (setting) dim = &single;
+                    else if (!strcmp(key, "C1")) dim = &sweep.c1;
+                    else if (!strcmp(key, "B")) dim = &sweep.b;
+                    else if (!strcmp(key, "S1")) dim = &sweep.s1;
+                    else if (sweep.l1_grid) dim = NULL;
+                    else if (!strcmp(key, "prefetch")) dim = &sweep.prefetch;
+                    else if (!strcmp(key, "C2")) dim = &sweep.c2;
+                    else if (!strcmp(key, "S2")) dim = &sweep.s2;
+                    else if (!strcmp(key, "r")) dim = &sweep.r;
+                }
+                if (!dim || parse_values(eq + 1, *dim, dim == &sweep.prefetch)
+                    || (setting && (single.size() != 1 || (setting != &sweep.budget && single[0] < 1)))) {
+                    fprintf(stderr, "%s:%d: bad sweep parameter '%s'\n", path, lineno, words[i]);
+                    fclose(in);
+                    return 1;
+                }
+                if (setting) {
+                    *setting = single[0];
+                }
+            }
+            sweeps.push_back(sweep);
+        } else {
+            fprintf(stderr, "%s:%d: expected 'trace <name> <path>', or 'sweep', 'l1grid' or 'search' <output> key=values...\n", path, lineno);
+            fclose(in);
+            return 1;
+        }
+    }
+    fclose(in);
+
+    if (traces.empty() || sweeps.empty()) {
+        fprintf(stderr, "%s: need at least one trace and one sweep\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+// Enumerate the legal points in the same order search.sh visits them
+static std::vector<SweepPoint> expand_sweep(const Sweep &sweep, size_t n_traces) {
+    std::vector<SweepPoint> points;
+    for (size_t t = 0; t < n_traces; t++)
+    for (uint64_t pf : sweep.prefetch)
+    for (uint64_t c1 : sweep.c1)
+    for (uint64_t b : sweep.b)
+    for (uint64_t s1 : sweep.s1)
+    for (uint64_t c2 : sweep.c2)
+    for (uint64_t s2 : sweep.s2)
+    for (uint64_t r : sweep.r) {
+        SweepPoint point;
+        point.trace = t;
+        point.config = DEFAULT_SIM_CONFIG;
+        point.config.l1_config.c = c1;
+        point.config.l1_config.b = b;
+        point.config.l1_config.s = s1;
+        point.config.l2_config.c = c2;
+        point.config.l2_config.b = b;
+        point.config.l2_config.s = s2;
+        point.config.l2_config.prefetch_algorithm = (prefetch_algo_t)pf;
+        point.config.l2_config.n_markov_rows = r;
+        point.config.l2_config.disabled = sweep.l1_grid;
+        memset(&point.stats, 0, sizeof point.stats);
+        point.storage = 0;
+        point.pareto = false;
+        if (CacheSimulator::check_config(point.config, NULL)) {
+            points.push_back(point);
+        }
+    }
+    return points;
+}
+
+// Same columns and precision as search.sh scraped from print_statistics
+static void write_csv_fields(FILE *out, const SweepTrace &trace, const SweepPoint &point) {
+    const cache_config_t &l1 = point.config.l1_config;
+    const cache_config_t &l2 = point.config.l2_config;
+    const sim_stats_t &s = point.stats;
+    fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%s,%" PRIu64,
+            trace.name.c_str(), l1.c, l1.b, l1.s, l2.c, l2.s,
+            PREFETCH_NAMES[l2.prefetch_algorithm], l2.n_markov_rows);
+    fprintf(out, ",%.3f,%.3f,%.3f,%.3f,%.3f,%.3f",
+            s.avg_access_time_l1, s.hit_ratio_l1, s.miss_ratio_l1,
+            s.avg_access_time_l2, s.read_hit_ratio_l2, s.read_miss_ratio_l2);
+    fprintf(out, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64,
+            s.prefetches_issued_l2, s.prefetch_hits_l2, s.prefetch_misses_l2,
+            s.misses_l1, s.read_hits_l2, s.read_misses_l2, s.write_backs_l1);
+}
+
+static void write_csv_row(FILE *out, const SweepTrace &trace, const SweepPoint &point) {
+    write_csv_fields(out, trace, point);
+    fputc('\n', out);
+}
+
+// Storage model of the analysis notebook: the data, plus per block a tag
+// (64 - C + S bits), a valid and a dirty bit, and a prefetched bit in a
+// prefetching L2. A Markov table row holds a block address and
+// MARKOV_ENTRIES (successor block address, 8-bit count) pairs.
+static uint64_t storage_bytes(const sim_config_t &config) {
+    const cache_config_t &l1 = config.l1_config;
+    const cache_config_t &l2 = config.l2_config;
+    uint64_t bits = (1ULL << l1.c) * 8 + (1ULL << (l1.c - l1.b)) * (64 - l1.c + l1.s + 2);
+    if (!l2.disabled) {
+        bool prefetching = l2.prefetch_algorithm != PREFETCH_NONE;
+        uint64_t addr_bits = 64 - l2.b;
+        bits += (1ULL << l2.c) * 8 + (1ULL << (l2.c - l2.b)) * (64 - l2.c + l2.s + 2 + prefetching);
+        bits += l2.n_markov_rows * (addr_bits + MARKOV_ENTRIES * (addr_bits + 8));
+    }
+    return (bits + 7) / 8;
+}
+
+// Mark the points on the (storage, L1 AAT) Pareto frontier of cands, then
+// of what is left, and so on, until `keep` of them are marked: the
+// non-dominated sorting successive halving selects survivors with
+static std::vector<size_t> select_survivors(const std::vector<SweepPoint> &points,
+                                            std::vector<size_t> cands, size_t keep) {
+    std::sort(cands.begin(), cands.end(), [&points](size_t x, size_t y) {
+        const SweepPoint &a = points[x], &b = points[y];
+        if (a.storage != b.storage) {
+            return a.storage < b.storage;
+        }
+        return a.stats.avg_access_time_l1 < b.stats.avg_access_time_l1;
+    });
+    std::vector<size_t> kept;
+    while (kept.size() < keep && !cands.empty()) {
+        // one frontier: each point faster than every cheaper one left
+        std::vector<size_t> layer, rest;
+        double best = INFINITY;
+        for (size_t i : cands) {
+            if (points[i].stats.avg_access_time_l1 < best) {
+                best = points[i].stats.avg_access_time_l1;
+                layer.push_back(i);
+            } else {
+                rest.push_back(i);
+            }
+        }
+        if (kept.size() + layer.size() > keep) {
+            // split the last layer by AAT
+            std::sort(layer.begin(), layer.end(), [&points](size_t x, size_t y) {
+                return points[x].stats.avg_access_time_l1 < points[y].stats.avg_access_time_l1;
+            });
+            layer.resize(keep - kept.size());
+        }
+        kept.insert(kept.end(), layer.begin(), layer.end());
+        cands.swap(rest);
+    }
+    return kept;
+}
+
+static std::vector<SweepPoint> run_search(const Sweep &sweep, const std::vector<SweepTrace> &traces,
+                                          ThreadPool &pool, ResultCache *results) {
+    std::vector<SweepPoint> points;
+    for (SweepPoint &point : expand_sweep(sweep, traces.size())) {
+        point.storage = storage_bytes(point.config);
+        if (point.storage <= sweep.budget) {
+            points.push_back(point);
+        }
+    }
+
+    // per point: its simulator and raw counters so far, and how many
+    // records it has seen; stored results count as finished
+    std::vector<std::unique_ptr<CacheSimulator>> sims(points.size());
+    std::vector<sim_stats_t> counters(points.size());
+    std::vector<uint64_t> done(points.size(), 0);
+    std::vector<bool> stored(points.size(), false);
+    for (size_t i = 0; results && i < points.size(); i++) {
+        stored[i] = results->lookup(traces[points[i].trace].hash, points[i].config, &points[i].stats);
+    }
+
+    std::vector<std::vector<size_t>> alive(traces.size());
+    for (size_t i = 0; i < points.size(); i++) {
+        alive[points[i].trace].push_back(i);
+    }
+
+    uint64_t simulated = 0;
+    for (uint64_t rung = 0; rung < sweep.rungs; rung++) {
+        // prefix length: a 1/eta^(rungs - 1 - rung) share of the trace
+        double share = 1.0;
+        for (uint64_t k = rung + 1; k < sweep.rungs; k++) {
+            share /= sweep.eta;
+        }
+        for (size_t t = 0; t < traces.size(); t++) {
+            const std::vector<uint64_t> &recs = traces[t].recs;
+            uint64_t len = rung + 1 == sweep.rungs ? recs.size()
+                : std::min<uint64_t>(recs.size(), std::max<uint64_t>(1, (uint64_t)(recs.size() * share)));
+            for (size_t i : alive[t]) {
+                if (stored[i] || done[i] >= len) {
+                    continue;
+                }
+                simulated += len - done[i];
+                SweepPoint *p = &points[i];
+                std::unique_ptr<CacheSimulator> *sim = &sims[i];
+                sim_stats_t *c = &counters[i];
+                const uint64_t *from = recs.data() + done[i];
+                uint64_t n = len - done[i];
+                done[i] = len;
+                pool.submit([p, sim, c, from, n] {
+                    if (!*sim) {
+                        sim->reset(new CacheSimulator(p->config));
+                        memset(c, 0, sizeof *c);
+                    }
+                    (*sim)->access_batch(from, n, c);
+                    p->stats = *c;
+                    (*sim)->finish(&p->stats);
+                });
+            }
+        }
+        pool.wait();
+
+        if (rung + 1 < sweep.rungs) {
+            for (size_t t = 0; t < traces.size(); t++) {
+                size_t keep = (alive[t].size() + sweep.eta - 1) / sweep.eta;
+                std::vector<size_t> next = select_survivors(points, alive[t], keep);
+                std::vector<bool> survives(points.size(), false);
+                for (size_t i : next) {
+                    survives[i] = true;
+                }
+                for (size_t i : alive[t]) {
+                    if (!survives[i]) {
+                        sims[i].reset();
+                    }
+                }
+                alive[t].swap(next);
+            }
+        }
+    }
+
+    // the survivors have run on whole traces; report them and their frontier
+    std::vector<SweepPoint> out;
+    uint64_t exhaustive = 0;
+    for (size_t t = 0; t < traces.size(); t++) {
+        std::vector<size_t> sorted = alive[t];
+        std::sort(sorted.begin(), sorted.end(), [&points](size_t x, size_t y) {
+            const SweepPoint &a = points[x], &b = points[y];
+            return a.storage != b.storage ? a.storage < b.storage
+                : a.stats.avg_access_time_l1 < b.stats.avg_access_time_l1;
+        });
+        double best_aat = INFINITY;
+        for (size_t i : sorted) {
+            points[i].pareto = points[i].stats.avg_access_time_l1 < best_aat;
+            best_aat = std::min(best_aat, points[i].stats.avg_access_time_l1);
+            out.push_back(points[i]);
+            if (results && !stored[i]) {
+                results->store(traces[t].hash, points[i].config, &points[i].stats);
+            }
+        }
+        size_t n_frontier = 0, best = alive[t].empty() ? 0 : alive[t][0];
+        for (size_t i : alive[t]) {
+            n_frontier += points[i].pareto;
+            if (points[i].stats.avg_access_time_l1 < points[best].stats.avg_access_time_l1) {
+                best = i;
+            }
+        }
+        for (const SweepPoint &point : points) {
+            exhaustive += point.trace == t ? traces[t].recs.size() : 0;
+        }
+        if (!alive[t].empty()) {
+            const SweepPoint &b = points[best];
+            printf("%s: best L1 AAT %.3f at C1=%" PRIu64 " B=%" PRIu64 " S1=%" PRIu64 " C2=%" PRIu64
+                   " S2=%" PRIu64 " prefetch=%s r=%" PRIu64 " (%" PRIu64 " bytes), %zu on the frontier\n",
+                   traces[t].name.c_str(), b.stats.avg_access_time_l1, b.config.l1_config.c, b.config.l1_config.b,
+                   b.config.l1_config.s, b.config.l2_config.c, b.config.l2_config.s,
+                   PREFETCH_NAMES[b.config.l2_config.prefetch_algorithm], b.config.l2_config.n_markov_rows,
+                   b.storage, n_frontier);
+        }
+    }
+    printf("%s: %zu candidates within budget, simulated %.1f%% of the accesses an exhaustive sweep would\n",
+           sweep.output.c_str(), points.size(), exhaustive ? 100.0 * simulated / exhaustive : 0.0);
+    return out;
+}
+
+// Per-set stack distances for one (B, set count) pair, which serves every
+// associativity with that many sets
+struct GridGroup {
+    uint64_t b;
+    uint64_t idx_bits;
+    std::vector<StackDistance> sets;
+    // hist[d] = references with per-set stack distance d < hist.size()
+    std::vector<uint64_t> hist;
+};
+
+static void run_l1_grid(const std::vector<SweepPoint> &points, const SweepTrace &trace,
+                        std::vector<sim_stats_t *> &stats) {
+    std::vector<GridGroup> groups;
+    std::vector<size_t> point_group;
+    for (const SweepPoint &point : points) {
+        const cache_config_t &l1 = point.config.l1_config;
+        uint64_t idx_bits = l1.c - l1.b - l1.s;
+        size_t g = 0;
+        while (g < groups.size() && !(groups[g].b == l1.b && groups[g].idx_bits == idx_bits)) {
+            g++;
+        }
+        if (g == groups.size()) {
+            GridGroup group;
+            group.b = l1.b;
+            group.idx_bits = idx_bits;
+            group.sets.resize(1ULL << idx_bits);
+            groups.push_back(group);
+        }
+        if (groups[g].hist.size() < (1ULL << l1.s)) {
+            groups[g].hist.resize(1ULL << l1.s, 0);
+        }
+        point_group.push_back(g);
+    }
+
+    uint64_t writes = 0;
+    for (uint64_t rec : trace.recs) {
+        uint64_t addr = trace_addr(rec);
+        writes += trace_rw(rec) == WRITE;
+        for (GridGroup &group : groups) {
+            uint64_t block_addr = addr >> group.b;
+            uint64_t idx = block_addr & ((1ULL << group.idx_bits) - 1);
+            uint64_t d = group.sets[idx].access(block_addr >> group.idx_bits);
+            if (d < group.hist.size()) {
+                group.hist[d]++;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < points.size(); i++) {
+        const GridGroup &group = groups[point_group[i]];
+        uint64_t ways = 1ULL << points[i].config.l1_config.s;
+        sim_stats_t *s = stats[i];
+        s->reads = trace.recs.size() - writes;
+        s->writes = writes;
+        s->accesses_l1 = trace.recs.size();
+        for (uint64_t d = 0; d < ways; d++) {
+            s->hits_l1 += group.hist[d];
+        }
+        s->misses_l1 = s->accesses_l1 - s->hits_l1;
+        s->reads_l2 = s->misses_l1;
+        s->read_misses_l2 = s->misses_l1;
+        CacheSimulator::finish_stats(points[i].config, s);
+    }
+}
+
+static void write_l1_grid_csv_row(FILE *out, const SweepTrace &trace, const SweepPoint &point) {
+    const cache_config_t &l1 = point.config.l1_config;
+    const sim_stats_t &s = point.stats;
+    fprintf(out, "%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,%.3f,%.3f\n",
+            trace.name.c_str(), l1.c, l1.b, l1.s,
+            s.accesses_l1, s.hits_l1, s.misses_l1,
+            s.hit_ratio_l1, s.miss_ratio_l1, s.avg_access_time_l1);
+}
+
+static void print_help(void) {
+    printf("cachesim-sweep [OPTIONS] <spec>\n");
+    printf("Runs every configuration of a sweep spec in-process and writes one CSV per sweep\n");
+    printf("-h\t\tThis helpful output\n");
+    printf("-j N\t\tNumber of worker threads (default: one per hardware thread)\n");
+    printf("-m DIR\t\tResult store: only simulate points without a stored result, store the new ones\n");
+}
@@ -0,0 +1,134 @@
+#include "epoch_series.hpp"
+#include <errno.h>
+#include <inttypes.h>
+#include <string.h>
+#include "cache_simulator.hpp"
+
+EpochSeries::EpochSeries() : out(NULL), binary(false), length(0), failed(false), done(false) {
+    memset(&config, 0, sizeof config);
+    memset(&last, 0, sizeof last);
+}
+
+EpochSeries::~EpochSeries() {
+    close(NULL);
+}
+
+bool EpochSeries::open(const char *file, const sim_config_t &sim_config, uint64_t epoch_length,
+                       const sim_stats_t &start, std::string *error) {
+    path = file;
+    size_t len = path.size();
+    binary = len >= 4 && path.compare(len - 4, 4, ".bin") == 0;
+    if (!(out = fopen(file, binary ? "wb" : "w"))) {
+        if (error) {
+            *error = path + ": " + strerror(errno);
+        }
+        return false;
+    }
+    config = sim_config;
+    length = epoch_length;
+    last.stats = start;
+
+    if (binary) {
+        epoch_header_t header;
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, EPOCH_MAGIC, sizeof header.magic);
+        header.version = EPOCH_VERSION;
+        header.record_size = sizeof(epoch_record_t);
+        header.epoch_length = epoch_length;
+        fwrite(&header, sizeof header, 1, out);
+    } else {
+        fprintf(out, "epoch,end,reads,writes,hits_l1,misses_l1,write_backs_l1,reads_l2,read_hits_l2,"
+                     "read_misses_l2,prefetches_issued_l2,prefetch_hits_l2,prefetch_misses_l2,"
+                     "hit_ratio_l1,read_hit_ratio_l2,avg_access_time_l1\n");
+    }
+    writer = std::thread(&EpochSeries::run, this);
+    return true;
+}
+
+void EpochSeries::flush() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        back.insert(back.end(), front.begin(), front.end());
+    }
+    ready.notify_one();
+    front.clear();
+}
+
+void EpochSeries::run() {
+    std::vector<Snapshot> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return !back.empty() || done; });
+            if (back.empty()) {
+                return;
+            }
+            batch.swap(back);
+        }
+        for (const Snapshot &snap : batch) {
+            write_epoch(snap);
+        }
+        batch.clear();
+    }
+}
+
+void EpochSeries::write_epoch(const Snapshot &snap) {
+    const sim_stats_t &a = last.stats;
+    const sim_stats_t &b = snap.stats;
+    epoch_record_t rec;
+    rec.end = snap.pos;
+    rec.reads = b.reads - a.reads;
+    rec.writes = b.writes - a.writes;
+    rec.hits_l1 = b.hits_l1 - a.hits_l1;
+    rec.misses_l1 = b.misses_l1 - a.misses_l1;
+    rec.write_backs_l1 = b.write_backs_l1 - a.write_backs_l1;
+    rec.reads_l2 = b.reads_l2 - a.reads_l2;
+    rec.read_hits_l2 = b.read_hits_l2 - a.read_hits_l2;
+    rec.read_misses_l2 = b.read_misses_l2 - a.read_misses_l2;
+    rec.prefetches_issued_l2 = b.prefetches_issued_l2 - a.prefetches_issued_l2;
+    rec.prefetch_hits_l2 = b.prefetch_hits_l2 - a.prefetch_hits_l2;
+    rec.prefetch_misses_l2 = b.prefetch_misses_l2 - a.prefetch_misses_l2;
+    uint64_t accesses_l1 = b.accesses_l1 - a.accesses_l1;
+    last = snap;
+
+    if (binary) {
+        failed |= fwrite(&rec, sizeof rec, 1, out) != 1;
+        return;
+    }
+    // this epoch's ratios and AAT, as sim_finish() would give them
+    sim_stats_t delta;
+    memset(&delta, 0, sizeof delta);
+    delta.accesses_l1 = accesses_l1;
+    delta.hits_l1 = rec.hits_l1;
+    delta.misses_l1 = rec.misses_l1;
+    delta.reads_l2 = rec.reads_l2;
+    delta.read_hits_l2 = rec.read_hits_l2;
+    delta.read_misses_l2 = rec.read_misses_l2;
+    CacheSimulator::finish_stats(config, &delta);
+    failed |= fprintf(out, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                      ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.6f,%.6f,%.4f\n",
+                      (rec.end - 1) / length, rec.end, rec.reads, rec.writes, rec.hits_l1, rec.misses_l1, rec.write_backs_l1,
+                      rec.reads_l2, rec.read_hits_l2, rec.read_misses_l2, rec.prefetches_issued_l2,
+                      rec.prefetch_hits_l2, rec.prefetch_misses_l2, delta.hit_ratio_l1, delta.read_hit_ratio_l2,
+                      delta.avg_access_time_l1) < 0;
+}
+
+bool EpochSeries::close(std::string *error) {
+    if (!out) {
+        return true;
+    }
+    flush();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    ready.notify_one();
+    writer.join();
+    bool ok = !failed && !ferror(out);
+    ok = fclose(out) == 0 && ok;
+    out = NULL;
+    if (!ok && error) {
+        *error = path + ": write error";
+    }
+    return ok;
+}
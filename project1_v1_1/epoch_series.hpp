@@ -0,0 +1,95 @@
+#ifndef EPOCH_SERIES_HPP
+#define EPOCH_SERIES_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cachesim.hpp"
+
+// Binary series: an epoch_header_t, then one epoch_record_t per epoch, all
+// in host byte order. Counts are for that epoch alone.
+static const char EPOCH_MAGIC[8] = {'C', 'S', 'I', 'M', 'E', 'P', 'C', 'H'};
+static const uint32_t EPOCH_VERSION = 1;
+typedef struct epoch_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t epoch_length;
+} epoch_header_t;
+
+typedef struct epoch_record {
+    // trace position (references) at the end of the epoch
+    uint64_t end;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t hits_l1;
+    uint64_t misses_l1;
+    uint64_t write_backs_l1;
+    uint64_t reads_l2;
+    uint64_t read_hits_l2;
+    uint64_t read_misses_l2;
+    uint64_t prefetches_issued_l2;
+    uint64_t prefetch_hits_l2;
+    uint64_t prefetch_misses_l2;
+} epoch_record_t;
+
+// Per-epoch statistics, streamed to a file. The simulating thread only
+// copies the running sim_stats_t at each epoch boundary into a buffer;
+// a writer thread takes full buffers, subtracts consecutive snapshots and
+// formats them, so the series can stay on for full runs.
+class EpochSeries {
+public:
+    EpochSeries();
+    ~EpochSeries();
+
+    // Write to path: binary if it ends in ".bin", CSV otherwise. Epoch k
+    // covers references [k * epoch_length, (k + 1) * epoch_length). start
+    // is the running stats the first epoch counts from (non-zero after a
+    // checkpoint restore). Returns false, with a message in *error, on
+    // failure.
+    bool open(const char *path, const sim_config_t &config, uint64_t epoch_length, const sim_stats_t &start,
+              std::string *error);
+    // The running stats at trace position pos, the end of an epoch
+    void record(uint64_t pos, const sim_stats_t &stats) {
+        front.push_back(Snapshot{pos, stats});
+        if (front.size() == FLUSH_EVERY) {
+            flush();
+        }
+    }
+    // Write what is left and stop the writer; false on a write error
+    bool close(std::string *error);
+
+private:
+    struct Snapshot {
+        uint64_t pos;
+        sim_stats_t stats;
+    };
+    static const size_t FLUSH_EVERY = 256;
+
+    void flush();
+    void run();
+    void write_epoch(const Snapshot &snap);
+
+    std::string path;
+    FILE *out;
+    bool binary;
+    sim_config_t config;
+    uint64_t length;
+    Snapshot last;
+    bool failed;
+
+    // the simulating thread fills front; flush() moves it to back, which
+    // the writer drains
+    std::vector<Snapshot> front;
+    std::vector<Snapshot> back;
+    std::mutex lock;
+    std::condition_variable ready;
+    bool done;
+    std::thread writer;
+};
+
+#endif /* EPOCH_SERIES_HPP */
@@ -0,0 +1,105 @@
+#include "instrument.hpp"
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+void ShadowCache::init(uint64_t n_blocks) {
+    capacity = n_blocks;
+    lru.clear();
+    where.clear();
+    where.reserve(n_blocks);
+}
+
+bool ShadowCache::access(uint64_t block) {
+    auto it = where.find(block);
+    if (it != where.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+        return true;
+    }
+    if (lru.size() == capacity) {
+        where.erase(lru.back());
+        lru.pop_back();
+    }
+    lru.push_front(block);
+    where.emplace(block, lru.begin());
+    return false;
+}
+
+void ShadowCache::touch(uint64_t block) {
+    auto it = where.find(block);
+    if (it != where.end()) {
+        lru.splice(lru.begin(), lru, it->second);
+    }
+}
+
+void LevelInstrument::init(uint64_t n_sets, uint64_t n_ways) {
+    sets = n_sets;
+    ways = n_ways;
+    accesses.assign(sets, 0);
+    set_misses.assign(sets * N_MISS_CLASSES, 0);
+    evictions.assign(sets, 0);
+    frame_hits.assign(sets * ways, 0);
+    memset(totals, 0, sizeof totals);
+    seen.clear();
+    shadow.init(sets * ways);
+}
+
+void LevelInstrument::report(sim_miss_classes_t *out) const {
+    out->compulsory = totals[MISS_COMPULSORY];
+    out->capacity = totals[MISS_CAPACITY];
+    out->conflict = totals[MISS_CONFLICT];
+}
+
+static FILE *open_output(const std::string &path, std::string *error) {
+    FILE *f = fopen(path.c_str(), "w");
+    if (!f && error) {
+        *error = path + ": " + strerror(errno);
+    }
+    return f;
+}
+
+static bool close_output(FILE *f, const std::string &path, std::string *error) {
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    if (!ok && error) {
+        *error = path + ": write error";
+    }
+    return ok;
+}
+
+bool LevelInstrument::dump(const std::string &prefix, std::string *error) const {
+    std::string path = prefix + "_sets.csv";
+    FILE *f = open_output(path, error);
+    if (!f) {
+        return false;
+    }
+    fprintf(f, "set,accesses,misses,compulsory,capacity,conflict,evictions\n");
+    for (uint64_t s = 0; s < sets; s++) {
+        const uint64_t *m = &set_misses[s * N_MISS_CLASSES];
+        fprintf(f, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", s,
+                accesses[s], m[MISS_COMPULSORY] + m[MISS_CAPACITY] + m[MISS_CONFLICT], m[MISS_COMPULSORY],
+                m[MISS_CAPACITY], m[MISS_CONFLICT], evictions[s]);
+    }
+    if (!close_output(f, path, error)) {
+        return false;
+    }
+
+    path = prefix + "_frames.csv";
+    if (!(f = open_output(path, error))) {
+        return false;
+    }
+    fprintf(f, "set");
+    for (uint64_t w = 0; w < ways; w++) {
+        fprintf(f, ",way%" PRIu64, w);
+    }
+    fprintf(f, "\n");
+    for (uint64_t s = 0; s < sets; s++) {
+        fprintf(f, "%" PRIu64, s);
+        for (uint64_t w = 0; w < ways; w++) {
+            fprintf(f, ",%" PRIu64, frame_hits[s * ways + w]);
+        }
+        fprintf(f, "\n");
+    }
+    return close_output(f, path, error);
+}
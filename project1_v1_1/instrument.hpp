@@ -0,0 +1,102 @@
+#ifndef INSTRUMENT_HPP
+#define INSTRUMENT_HPP
+
+#include <stdint.h>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "cachesim.hpp"
+
+// Optional instrumentation of the access path: three-C miss
+// classification and per-set / per-frame counters for heat maps. Built
+// with `make INSTRUMENT=1`, which defines CACHESIM_INSTRUMENT; otherwise
+// every INSTRUMENT(...) hook compiles to nothing.
+#ifdef CACHESIM_INSTRUMENT
+#define INSTRUMENT(...) __VA_ARGS__
+#else
+#define INSTRUMENT(...)
+#endif
+
+enum miss_class {
+    // first reference to the block
+    MISS_COMPULSORY,
+    // a fully associative LRU cache of the same size misses too
+    MISS_CAPACITY,
+    // only the set mapping misses: more ways would have hit
+    MISS_CONFLICT,
+    N_MISS_CLASSES
+};
+
+// A fully associative LRU cache of a fixed number of blocks
+class ShadowCache {
+public:
+    void init(uint64_t n_blocks);
+    // Reference block, installing it; returns whether it hit
+    bool access(uint64_t block);
+    // Make block MRU if present (write-no-allocate writes)
+    void touch(uint64_t block);
+
+private:
+    uint64_t capacity = 0;
+    // MRU first
+    std::list<uint64_t> lru;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> where;
+};
+
+// Counters for one cache level. Sets and ways index like CacheArray;
+// blocks are block addresses of that level.
+class LevelInstrument {
+public:
+    void init(uint64_t n_sets, uint64_t n_ways);
+    // A demand reference to block in set; way is the hit way, or -1 for a
+    // miss, which gets classified
+    void access(uint64_t set, int way, uint64_t block) {
+        accesses[set]++;
+        bool seen_before = !seen.insert(block).second;
+        bool shadow_hit = shadow.access(block);
+        if (way >= 0) {
+            frame_hits[set * ways + way]++;
+            return;
+        }
+        miss_class c = !seen_before ? MISS_COMPULSORY : shadow_hit ? MISS_CONFLICT : MISS_CAPACITY;
+        set_misses[set * N_MISS_CLASSES + c]++;
+        totals[c]++;
+    }
+    // A write-no-allocate write to block; way is where it hit, or -1
+    void write(uint64_t set, int way, uint64_t block) {
+        accesses[set]++;
+        if (way >= 0) {
+            frame_hits[set * ways + way]++;
+            shadow.touch(block);
+        }
+    }
+    // block installed without a demand reference (a prefetch)
+    void fill(uint64_t block) {
+        seen.insert(block);
+        shadow.access(block);
+    }
+    // A valid block was replaced in set
+    void evict(uint64_t set) { evictions[set]++; }
+
+    void report(sim_miss_classes_t *out) const;
+    // Write prefix_sets.csv (per-set accesses, misses by class and
+    // evictions) and prefix_frames.csv (a sets x ways matrix of hits).
+    // Returns false, with a message in *error, on failure.
+    bool dump(const std::string &prefix, std::string *error) const;
+
+private:
+    uint64_t sets = 0;
+    uint64_t ways = 0;
+    std::vector<uint64_t> accesses;
+    // N_MISS_CLASSES per set
+    std::vector<uint64_t> set_misses;
+    std::vector<uint64_t> evictions;
+    std::vector<uint64_t> frame_hits;
+    uint64_t totals[N_MISS_CLASSES] = {0, 0, 0};
+    std::unordered_set<uint64_t> seen;
+    ShadowCache shadow;
+};
+
+#endif /* INSTRUMENT_HPP */
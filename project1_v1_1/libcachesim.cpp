@@ -0,0 +1,139 @@
+#include "libcachesim.h"
+#include "cache_simulator.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <string>
+
+struct cachesim {
+    std::unique_ptr<CacheSimulator> sim;
+    sim_stats_t stats;
+    uint64_t pos;
+};
+
+// Packed records per chunk when packing addresses for cachesim_access_addrs()
+static const size_t PACK_CHUNK = 4096;
+
+static void set_error(char *error, size_t error_size, const std::string &message) {
+    if (error && error_size) {
+        snprintf(error, error_size, "%s", message.c_str());
+    }
+}
+
+unsigned cachesim_api_version(void) {
+    return CACHESIM_API_VERSION;
+}
+
+void cachesim_default_config(sim_config_t *out) {
+    *out = DEFAULT_SIM_CONFIG;
+}
+
+cachesim_t *cachesim_create(const sim_config_t *config, char *error, size_t error_size) {
+    // the constructor exits on a bad configuration; a library must not
+    std::string message;
+    if (!CacheSimulator::check_config(*config, &message)) {
+        set_error(error, error_size, message);
+        return NULL;
+    }
+    cachesim_t *handle = new cachesim_t();
+    handle->sim.reset(new CacheSimulator(*config));
+    return handle;
+}
+
+void cachesim_destroy(cachesim_t *sim) {
+    delete sim;
+}
+
+void cachesim_access_batch(cachesim_t *sim, const uint64_t *recs, size_t n) {
+    sim->sim->access_batch(recs, n, &sim->stats);
+    sim->pos += n;
+}
+
+void cachesim_access_addrs(cachesim_t *sim, const uint64_t *addrs, const uint8_t *writes, size_t n) {
+    if (!writes) {
+        // reads are already packed, as long as bit 63 is clear
+        bool packed = true;
+        for (size_t i = 0; i < n && packed; i++) {
+            packed = !(addrs[i] & CACHESIM_WRITE_BIT);
+        }
+        if (packed) {
+            cachesim_access_batch(sim, addrs, n);
+            return;
+        }
+    }
+    uint64_t chunk[PACK_CHUNK];
+    for (size_t done = 0; done < n;) {
+        size_t len = n - done < PACK_CHUNK ? n - done : PACK_CHUNK;
+        for (size_t i = 0; i < len; i++) {
+            chunk[i] = (addrs[done + i] & ACCESS_ADDR_MASK) | (writes && writes[done + i] ? ACCESS_WRITE_BIT : 0);
+        }
+        cachesim_access_batch(sim, chunk, len);
+        done += len;
+    }
+}
+
+void cachesim_warm_batch(cachesim_t *sim, const uint64_t *recs, size_t n) {
+    sim->sim->warm(recs, n);
+    sim->pos += n;
+}
+
+uint64_t cachesim_position(const cachesim_t *sim) {
+    return sim->pos;
+}
+
+void cachesim_stats(const cachesim_t *sim, sim_stats_t *out) {
+    *out = sim->stats;
+    sim->sim->finish(out);
+}
+
+void cachesim_reset_stats(cachesim_t *sim) {
+    memset(&sim->stats, 0, sizeof sim->stats);
+}
+
+int cachesim_snapshot(const cachesim_t *sim, void **data, size_t *size) {
+    char *buf = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&buf, &len);
+    if (!out) {
+        return 1;
+    }
+    std::string error;
+    bool ok = sim->sim->save_checkpoint(out, sim->pos, &sim->stats, &error);
+    ok = fclose(out) == 0 && ok;
+    if (!ok) {
+        free(buf);
+        return 1;
+    }
+    *data = buf;
+    *size = len;
+    return 0;
+}
+
+checkpoint_restore_t cachesim_restore(cachesim_t *sim, const void *data, size_t size, char *error,
+                                      size_t error_size) {
+    FILE *in = size ? fmemopen(const_cast<void *>(data), size, "rb") : NULL;
+    if (!in) {
+        set_error(error, error_size, "empty checkpoint image");
+        return CHECKPOINT_FAILED;
+    }
+    // restore into a fresh simulator, so a bad image leaves the handle as it was
+    std::unique_ptr<CacheSimulator> fresh(new CacheSimulator(sim->sim->get_config()));
+    uint64_t pos;
+    sim_stats_t stats = sim_stats_t();
+    std::string message;
+    checkpoint_restore_t result = fresh->restore_checkpoint(in, &pos, &stats, &message);
+    fclose(in);
+    if (result == CHECKPOINT_FAILED) {
+        set_error(error, error_size, message);
+        return result;
+    }
+    sim->sim.swap(fresh);
+    sim->stats = stats;
+    sim->pos = pos;
+    return result;
+}
+
+void cachesim_free(void *data) {
+    free(data);
+}
@@ -0,0 +1,67 @@
+#ifndef LIBCACHESIM_H
+#define LIBCACHESIM_H
+
+// The embedding API of libcachesim.so: independent simulator handles, fed
+// access batches from memory. Plain C, and the only symbols the library
+// exports. sim_config_t and sim_stats_t are shared with the simulator (see
+// cachesim.hpp); CACHESIM_API_VERSION changes whenever they or any
+// signature here change, so check cachesim_api_version() after loading.
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cachesim.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CACHESIM_API_VERSION 1
+#define CACHESIM_API __attribute__((visibility("default")))
+
+// Bit 63 of a packed access marks a write (access_t)
+#define CACHESIM_WRITE_BIT (1ULL << 63)
+
+typedef struct cachesim cachesim_t;
+
+CACHESIM_API unsigned cachesim_api_version(void);
+// The cachesim defaults: 1KB 2-way L1, 32KB 8-way L2, 64-byte blocks
+CACHESIM_API void cachesim_default_config(sim_config_t *out);
+
+// NULL on an invalid configuration, with the reason in error (if given)
+CACHESIM_API cachesim_t *cachesim_create(const sim_config_t *config, char *error, size_t error_size);
+CACHESIM_API void cachesim_destroy(cachesim_t *sim);
+
+// Simulate accesses in order: packed ones (CACHESIM_WRITE_BIT set for
+// writes), or addresses with an optional byte per access, nonzero for a
+// write (writes == NULL: all reads)
+CACHESIM_API void cachesim_access_batch(cachesim_t *sim, const uint64_t *recs, size_t n);
+CACHESIM_API void cachesim_access_addrs(cachesim_t *sim, const uint64_t *addrs, const uint8_t *writes, size_t n);
+// Update cache and prefetcher state only, counting nothing
+CACHESIM_API void cachesim_warm_batch(cachesim_t *sim, const uint64_t *recs, size_t n);
+// Accesses simulated or warmed so far
+CACHESIM_API uint64_t cachesim_position(const cachesim_t *sim);
+
+// The statistics so far, ratios and AATs filled in; the handle can go on
+// simulating
+CACHESIM_API void cachesim_stats(const cachesim_t *sim, sim_stats_t *out);
+// Zero the counters and keep the cache state, e.g. after a warmup
+CACHESIM_API void cachesim_reset_stats(cachesim_t *sim);
+
+// The complete state (caches, prefetcher, counters, position) as a
+// checkpoint image in a malloc()ed buffer the caller frees with
+// cachesim_free(). Returns 0 on success.
+CACHESIM_API int cachesim_snapshot(const cachesim_t *sim, void **data, size_t *size);
+// Restore an image from cachesim_snapshot() or `cachesim -x`. With only the
+// L1 configuration matching, just L1 is restored (CHECKPOINT_L1_ONLY) and
+// the counters restart at zero. The whole image is checked before any of
+// it is used: on CHECKPOINT_FAILED (a truncated or corrupt image, or a
+// different L1 configuration) the handle is unchanged.
+CACHESIM_API checkpoint_restore_t cachesim_restore(cachesim_t *sim, const void *data, size_t size, char *error,
+                                                   size_t error_size);
+CACHESIM_API void cachesim_free(void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBCACHESIM_H */
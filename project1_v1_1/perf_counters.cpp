@@ -0,0 +1,225 @@
+#include "perf_counters.hpp"
+#include <inttypes.h>
+#include <algorithm>
+#include <string>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char *const COUNTER_NAMES[N_PERF_COUNTERS] = {"cycles", "instructions", "LLC misses",
+                                                           "branch misses"};
+static const char *const PHASE_NAMES[N_PERF_PHASES] = {"read", "simulate", "finish"};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Time stamp counter ticks, or nanoseconds off x86
+static inline uint64_t timestamp(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static int open_counter(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the PMU may multiplex the counters; these let read_all() scale them
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+PerfCounters::PerfCounters() {
+    static const uint64_t CONFIGS[N_PERF_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int c = 0; c < N_PERF_COUNTERS; c++) {
+        fds[c] = open_counter(CONFIGS[c]);
+        at_start[c] = 0;
+    }
+    if (fds[PERF_CYCLES] < 0) {
+        // without cycles the rest is not worth much; use the fallback
+        for (int c = 0; c < N_PERF_COUNTERS; c++) {
+            if (fds[c] >= 0) {
+                close(fds[c]);
+                fds[c] = -1;
+            }
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int c = 0; c < N_PERF_COUNTERS; c++) {
+        if (fds[c] >= 0) {
+            close(fds[c]);
+        }
+    }
+}
+
+void PerfCounters::read_all(uint64_t *out) const {
+    for (int c = 0; c < N_PERF_COUNTERS; c++) {
+        uint64_t v[3];
+        if (fds[c] < 0) {
+            out[c] = c == PERF_CYCLES ? timestamp() : 0;
+        } else if (read(fds[c], v, sizeof v) != (ssize_t)sizeof v || !v[2]) {
+            out[c] = 0;
+        } else {
+            // value * enabled / running
+            out[c] = v[1] == v[2] ? v[0] : (uint64_t)((double)v[0] * v[1] / v[2]);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    secs_at_start = now();
+    read_all(at_start);
+}
+
+void PerfCounters::stop(PerfSample *into) {
+    uint64_t at_stop[N_PERF_COUNTERS];
+    read_all(at_stop);
+    for (int c = 0; c < N_PERF_COUNTERS; c++) {
+        into->counts[c] += at_stop[c] - at_start[c];
+    }
+    into->secs += now() - secs_at_start;
+}
+
+void PhaseProfiler::enable() {
+    if (!counters) {
+        counters = new PerfCounters();
+    }
+}
+
+void PhaseProfiler::report(FILE *out) const {
+    if (!counters) {
+        return;
+    }
+    bool hw = counters->hardware();
+    fprintf(out, "Host counters (%s):\n",
+            hw ? "perf_event_open, this thread, user space" : "perf_event_open unavailable, cycles are rdtsc ticks");
+    fprintf(out, "  %-9s %10s %9s %16s %16s %6s %14s %14s\n", "phase", "seconds", "M rec/s", COUNTER_NAMES[0],
+            COUNTER_NAMES[1], "IPC", COUNTER_NAMES[2], COUNTER_NAMES[3]);
+    for (int p = 0; p < N_PERF_PHASES; p++) {
+        const PerfSample &s = phases[p];
+        fprintf(out, "  %-9s %10.3f ", PHASE_NAMES[p], s.secs);
+        if (s.records && s.secs > 0) {
+            fprintf(out, "%9.1f ", s.records / s.secs / 1e6);
+        } else {
+            fprintf(out, "%9s ", "-");
+        }
+        fprintf(out, "%16" PRIu64 " ", s.counts[PERF_CYCLES]);
+        if (hw) {
+            fprintf(out, "%16" PRIu64 " %6.2f ", s.counts[PERF_INSTRUCTIONS],
+                    s.counts[PERF_CYCLES] ? (double)s.counts[PERF_INSTRUCTIONS] / s.counts[PERF_CYCLES] : 0.0);
+        } else {
+            fprintf(out, "%16s %6s ", "-", "-");
+        }
+        for (int c = PERF_LLC_MISSES; c < N_PERF_COUNTERS; c++) {
+            if (counters->available((perf_counter_t)c)) {
+                fprintf(out, "%14" PRIu64 "%s", s.counts[c], c + 1 < N_PERF_COUNTERS ? " " : "\n");
+            } else {
+                fprintf(out, "%14s%s", "-", c + 1 < N_PERF_COUNTERS ? " " : "\n");
+            }
+        }
+    }
+    // per record, where the phase handled records
+    for (int p = 0; p < N_PERF_PHASES; p++) {
+        const PerfSample &s = phases[p];
+        if (!s.records) {
+            continue;
+        }
+        fprintf(out, "  %s per record: %.1f %s", PHASE_NAMES[p], (double)s.counts[PERF_CYCLES] / s.records,
+                hw ? "cycles" : "ticks");
+        for (int c = PERF_INSTRUCTIONS; c < N_PERF_COUNTERS; c++) {
+            if (hw && counters->available((perf_counter_t)c)) {
+                fprintf(out, ", %.3f %s", (double)s.counts[c] / s.records, COUNTER_NAMES[c]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// Path bits: the level that served the access, then prefetch and write-back
+enum {
+    PATH_L1_HIT = 0,
+    PATH_L2_HIT = 1,
+    PATH_L2_MISS = 2,
+    PATH_PREFETCH = 1 << 2,
+    PATH_WRITE_BACK = 1 << 3,
+};
+
+PathProfile::PathProfile() {
+    // the cheapest of many back-to-back reads
+    overhead = UINT64_MAX;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t t0 = timestamp();
+        uint64_t t1 = timestamp();
+        overhead = std::min(overhead, t1 - t0);
+    }
+}
+
+void PathProfile::access_batch(const access_t *recs, size_t n, sim_stats_t *stats) {
+    for (size_t i = 0; i < n; i++) {
+        sim_stats_t before = *stats;
+        uint64_t t0 = timestamp();
+        sim_access_batch(&recs[i], 1, stats);
+        uint64_t t1 = timestamp();
+
+        unsigned path = stats->hits_l1 != before.hits_l1 ? PATH_L1_HIT
+            : stats->read_hits_l2 != before.read_hits_l2 ? PATH_L2_HIT : PATH_L2_MISS;
+        if (stats->prefetches_issued_l2 != before.prefetches_issued_l2) {
+            path |= PATH_PREFETCH;
+        }
+        if (stats->write_backs_l1 != before.write_backs_l1) {
+            path |= PATH_WRITE_BACK;
+        }
+        counts[path]++;
+        ticks[path] += t1 - t0 > overhead ? t1 - t0 - overhead : 0;
+    }
+}
+
+void PathProfile::report(FILE *out, bool l2_enabled) const {
+    uint64_t total_count = 0, total_ticks = 0;
+    for (unsigned p = 0; p < N_PATHS; p++) {
+        total_count += counts[p];
+        total_ticks += ticks[p];
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    const char *unit = "ticks";
+#else
+    const char *unit = "ns";
+#endif
+    fprintf(out, "Access paths (%s per access, less %" PRIu64 " of timer overhead):\n", unit, overhead);
+    fprintf(out, "  %-34s %14s %8s %12s %8s\n", "path", "accesses", "share", unit, "of time");
+    for (unsigned p = 0; p < N_PATHS; p++) {
+        if (!counts[p]) {
+            continue;
+        }
+        static const char *const LEVELS[] = {"L1 hit", "L2 hit", "L2 miss"};
+        std::string name = (p & 3) == PATH_L2_MISS && !l2_enabled ? "L1 miss" : LEVELS[p & 3];
+        if (p & PATH_PREFETCH) {
+            name += " + prefetch";
+        }
+        if (p & PATH_WRITE_BACK) {
+            name += " + write-back";
+        }
+        fprintf(out, "  %-34s %14" PRIu64 " %7.2f%% %12.1f %7.2f%%\n", name.c_str(), counts[p],
+                100.0 * counts[p] / total_count, (double)ticks[p] / counts[p],
+                total_ticks ? 100.0 * ticks[p] / total_ticks : 0.0);
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include "cachesim.hpp"
+
+// Host hardware counters, read through perf_event_open
+typedef enum perf_counter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES,
+    N_PERF_COUNTERS,
+} perf_counter_t;
+
+// Counts accumulated over every interval of one program phase
+struct PerfSample {
+    uint64_t counts[N_PERF_COUNTERS] = {};
+    double secs = 0;
+    uint64_t records = 0;
+};
+
+// The counters of the calling thread, user space only. Where
+// perf_event_open is refused (containers, perf_event_paranoid, no PMU in
+// the VM), cycles fall back to the time stamp counter and the other
+// counters read as unavailable.
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // false: the rdtsc fallback
+    bool hardware() const { return fds[PERF_CYCLES] >= 0; }
+    bool available(perf_counter_t c) const { return fds[c] >= 0 || c == PERF_CYCLES; }
+    // Adds the counts since the last start() to *into
+    void start();
+    void stop(PerfSample *into);
+
+private:
+    void read_all(uint64_t *out) const;
+
+    int fds[N_PERF_COUNTERS];
+    uint64_t at_start[N_PERF_COUNTERS];
+    double secs_at_start = 0;
+};
+
+// The phases of a cachesim run: getting the next batch of the trace
+// (decoding, or waiting on the decode thread with -t, or generating it),
+// simulating it, and sim_finish()
+typedef enum perf_phase {
+    PERF_PHASE_READ,
+    PERF_PHASE_SIMULATE,
+    PERF_PHASE_FINISH,
+    N_PERF_PHASES,
+} perf_phase_t;
+
+// Host counters per phase. begin()/end() bracket one interval; both do
+// nothing until enable().
+class PhaseProfiler {
+public:
+    void enable();
+    bool enabled() const { return counters != nullptr; }
+    void begin(perf_phase_t phase) {
+        if (counters) {
+            current = phase;
+            counters->start();
+        }
+    }
+    void end(uint64_t records = 0) {
+        if (counters) {
+            counters->stop(&phases[current]);
+            phases[current].records += records;
+        }
+    }
+    void report(FILE *out) const;
+    ~PhaseProfiler() { delete counters; }
+
+private:
+    PerfCounters *counters = nullptr;
+    perf_phase_t current = PERF_PHASE_READ;
+    PerfSample phases[N_PERF_PHASES];
+};
+
+// Time per access path. Each access goes through sim_access_batch() on its
+// own between two time stamp counter reads and is binned by what it did,
+// told from the change in the statistics: L1 hit, L2 hit or L2 miss, and
+// whether it issued a prefetch and wrote back a dirty L1 block. Slow, and
+// wrong under set sampling, whose counters are only merged at the end.
+class PathProfile {
+public:
+    PathProfile();
+    void access_batch(const access_t *recs, size_t n, sim_stats_t *stats);
+    void report(FILE *out, bool l2_enabled) const;
+
+private:
+    // indexed by the PATH_* bits in perf_counters.cpp
+    static const unsigned N_PATHS = 16;
+    uint64_t counts[N_PATHS] = {};
+    uint64_t ticks[N_PATHS] = {};
+    // ticks two back-to-back timestamp reads take, subtracted from each access
+    uint64_t overhead = 0;
+};
+
+#endif /* PERF_COUNTERS_HPP */
@@ -0,0 +1,400 @@
+// Python bindings for libcachesim.so. Addresses come in through the buffer
+// protocol, so NumPy arrays (uint64 addresses, bool or uint8 write flags),
+// array.array('Q') and memoryviews are read in place, without copies and
+// with the GIL released while simulating. A per-object lock serializes
+// calls on one handle, so threads can share a Simulator safely (they take
+// turns) or simulate on separate ones in parallel.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stddef.h>
+#include <string.h>
+#include "libcachesim.h"
+
+typedef struct {
+    PyObject_HEAD
+    cachesim_t *sim;
+    // held around every cachesim_*() call on sim, and when replacing it
+    PyThread_type_lock lock;
+} SimulatorObject;
+
+// Take self->lock. The holder may be waiting for the GIL, so only wait
+// for the lock with the GIL released.
+static void lock_sim(SimulatorObject *self) {
+    if (!PyThread_acquire_lock(self->lock, NOWAIT_LOCK)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, WAIT_LOCK);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+static void unlock_sim(SimulatorObject *self) {
+    PyThread_release_lock(self->lock);
+}
+
+// Counter and ratio fields of sim_stats_t, in declaration order
+typedef struct {
+    const char *name;
+    size_t offset;
+    int is_double;
+} StatsField;
+
+#define U64_FIELD(f) {#f, offsetof(sim_stats_t, f), 0}
+#define DOUBLE_FIELD(f) {#f, offsetof(sim_stats_t, f), 1}
+static const StatsField STATS_FIELDS[] = {
+    U64_FIELD(reads),
+    U64_FIELD(writes),
+    U64_FIELD(accesses_l1),
+    U64_FIELD(hits_l1),
+    U64_FIELD(misses_l1),
+    DOUBLE_FIELD(hit_ratio_l1),
+    DOUBLE_FIELD(miss_ratio_l1),
+    DOUBLE_FIELD(avg_access_time_l1),
+    U64_FIELD(write_backs_l1),
+    U64_FIELD(reads_l2),
+    U64_FIELD(writes_l2),
+    U64_FIELD(read_hits_l2),
+    U64_FIELD(read_misses_l2),
+    DOUBLE_FIELD(read_hit_ratio_l2),
+    DOUBLE_FIELD(read_miss_ratio_l2),
+    DOUBLE_FIELD(avg_access_time_l2),
+    U64_FIELD(prefetches_issued_l2),
+    U64_FIELD(prefetch_hits_l2),
+    U64_FIELD(prefetch_misses_l2),
+    U64_FIELD(windows),
+};
+
+static int parse_policy(const char *name, replacement_policy_t *out) {
+    if (!strcmp(name, "mip")) {
+        *out = REPLACEMENT_POLICY_MIP;
+    } else if (!strcmp(name, "lip")) {
+        *out = REPLACEMENT_POLICY_LIP;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown replacement policy '%s' (mip, lip)", name);
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_prefetch(const char *name, prefetch_algo_t *out) {
+    static const char *const NAMES[] = {"none", "plus1", "markov", "hybrid"};
+    for (int i = 0; i < 4; i++) {
+        if (!strcmp(name, NAMES[i])) {
+            *out = (prefetch_algo_t)i;
+            return 0;
+        }
+    }
+    PyErr_Format(PyExc_ValueError, "unknown prefetcher '%s' (none, plus1, markov, hybrid)", name);
+    return -1;
+}
+
+static int Simulator_init(SimulatorObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"c1", "b", "s1", "c2", "s2", "policy", "prefetch", "markov_rows", "l2", NULL};
+    sim_config_t config;
+    cachesim_default_config(&config);
+    unsigned long long c1 = config.l1_config.c, b = config.l1_config.b, s1 = config.l1_config.s;
+    unsigned long long c2 = config.l2_config.c, s2 = config.l2_config.s, rows = 0;
+    const char *policy = "lip", *prefetch = "none";
+    int l2 = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|$KKKKKssKp", keywords, &c1, &b, &s1, &c2, &s2, &policy,
+                                     &prefetch, &rows, &l2)) {
+        return -1;
+    }
+    config.l1_config.c = c1;
+    config.l1_config.b = config.l2_config.b = b;
+    config.l1_config.s = s1;
+    config.l2_config.c = c2;
+    config.l2_config.s = s2;
+    config.l2_config.n_markov_rows = rows;
+    config.l2_config.disabled = !l2;
+    if (parse_policy(policy, &config.l2_config.replace_policy)
+        || parse_prefetch(prefetch, &config.l2_config.prefetch_algorithm)) {
+        return -1;
+    }
+
+    char error[256];
+    cachesim_t *sim = cachesim_create(&config, error, sizeof error);
+    if (!sim) {
+        PyErr_SetString(PyExc_ValueError, error);
+        return -1;
+    }
+    // __init__ again replaces the handle; another thread may still be
+    // simulating on the old one
+    lock_sim(self);
+    cachesim_t *old = self->sim;
+    self->sim = sim;
+    unlock_sim(self);
+    cachesim_destroy(old);
+    return 0;
+}
+
+static PyObject *Simulator_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    SimulatorObject *self = (SimulatorObject *)type->tp_alloc(type, 0);
+    if (!self) {
+        return NULL;
+    }
+    self->lock = PyThread_allocate_lock();
+    if (!self->lock) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    return (PyObject *)self;
+}
+
+static void Simulator_dealloc(SimulatorObject *self) {
+    cachesim_destroy(self->sim);
+    if (self->lock) {
+        PyThread_free_lock(self->lock);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+// A contiguous buffer of n items of itemsize bytes, integers or bools
+static int get_array(PyObject *obj, Py_buffer *view, Py_ssize_t itemsize, const char *what) {
+    if (PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        return -1;
+    }
+    const char *fmt = view->format ? view->format : "B";
+    if (strchr("<>=!@", fmt[0])) {
+        fmt++;
+    }
+    if (view->itemsize != itemsize || !fmt[0] || fmt[1] || !strchr("bBhHiIlLqQnN?", fmt[0])) {
+        PyErr_Format(PyExc_TypeError, "%s must be a contiguous array of %zd-byte integers", what, itemsize);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+static int check_ready(SimulatorObject *self) {
+    if (!self->sim) {
+        PyErr_SetString(PyExc_RuntimeError, "Simulator.__init__ was not called");
+        return -1;
+    }
+    return 0;
+}
+
+static PyObject *Simulator_access(SimulatorObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"addrs", "writes", NULL};
+    PyObject *addrs_obj, *writes_obj = Py_None;
+    if (check_ready(self) || !PyArg_ParseTupleAndKeywords(args, kwargs, "O|O", keywords, &addrs_obj, &writes_obj)) {
+        return NULL;
+    }
+    Py_buffer addrs, writes;
+    if (get_array(addrs_obj, &addrs, 8, "addrs")) {
+        return NULL;
+    }
+    size_t n = (size_t)(addrs.len / 8);
+    const uint8_t *flags = NULL;
+    if (writes_obj != Py_None) {
+        if (get_array(writes_obj, &writes, 1, "writes")) {
+            PyBuffer_Release(&addrs);
+            return NULL;
+        }
+        if ((size_t)writes.len != n) {
+            PyErr_SetString(PyExc_ValueError, "addrs and writes differ in length");
+            PyBuffer_Release(&writes);
+            PyBuffer_Release(&addrs);
+            return NULL;
+        }
+        flags = (const uint8_t *)writes.buf;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    cachesim_access_addrs(self->sim, (const uint64_t *)addrs.buf, flags, n);
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+    if (flags) {
+        PyBuffer_Release(&writes);
+    }
+    PyBuffer_Release(&addrs);
+    Py_RETURN_NONE;
+}
+
+// access_packed() and warm(): one array of packed accesses
+static PyObject *run_packed(SimulatorObject *self, PyObject *arg, int warm) {
+    Py_buffer recs;
+    if (check_ready(self) || get_array(arg, &recs, 8, "records")) {
+        return NULL;
+    }
+    size_t n = (size_t)(recs.len / 8);
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    if (warm) {
+        cachesim_warm_batch(self->sim, (const uint64_t *)recs.buf, n);
+    } else {
+        cachesim_access_batch(self->sim, (const uint64_t *)recs.buf, n);
+    }
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&recs);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Simulator_access_packed(SimulatorObject *self, PyObject *arg) {
+    return run_packed(self, arg, 0);
+}
+
+static PyObject *Simulator_warm(SimulatorObject *self, PyObject *arg) {
+    return run_packed(self, arg, 1);
+}
+
+static PyObject *Simulator_stats(SimulatorObject *self, PyObject *unused) {
+    if (check_ready(self)) {
+        return NULL;
+    }
+    sim_stats_t stats;
+    lock_sim(self);
+    cachesim_stats(self->sim, &stats);
+    unlock_sim(self);
+    PyObject *dict = PyDict_New();
+    if (!dict) {
+        return NULL;
+    }
+    for (size_t i = 0; i < sizeof STATS_FIELDS / sizeof *STATS_FIELDS; i++) {
+        const char *p = (const char *)&stats + STATS_FIELDS[i].offset;
+        PyObject *value;
+        if (STATS_FIELDS[i].is_double) {
+            double d;
+            memcpy(&d, p, sizeof d);
+            value = PyFloat_FromDouble(d);
+        } else {
+            uint64_t u;
+            memcpy(&u, p, sizeof u);
+            value = PyLong_FromUnsignedLongLong(u);
+        }
+        if (!value || PyDict_SetItemString(dict, STATS_FIELDS[i].name, value)) {
+            Py_XDECREF(value);
+            Py_DECREF(dict);
+            return NULL;
+        }
+        Py_DECREF(value);
+    }
+    return dict;
+}
+
+static PyObject *Simulator_reset_stats(SimulatorObject *self, PyObject *unused) {
+    if (check_ready(self)) {
+        return NULL;
+    }
+    lock_sim(self);
+    cachesim_reset_stats(self->sim);
+    unlock_sim(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Simulator_snapshot(SimulatorObject *self, PyObject *unused) {
+    void *data;
+    size_t size;
+    if (check_ready(self)) {
+        return NULL;
+    }
+    lock_sim(self);
+    int failed = cachesim_snapshot(self->sim, &data, &size);
+    unlock_sim(self);
+    if (failed) {
+        return PyErr_NoMemory();
+    }
+    PyObject *bytes = PyBytes_FromStringAndSize((const char *)data, (Py_ssize_t)size);
+    cachesim_free(data);
+    return bytes;
+}
+
+static PyObject *Simulator_restore(SimulatorObject *self, PyObject *arg) {
+    Py_buffer image;
+    if (check_ready(self) || PyObject_GetBuffer(arg, &image, PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+    char error[256];
+    lock_sim(self);
+    checkpoint_restore_t result = cachesim_restore(self->sim, image.buf, (size_t)image.len, error, sizeof error);
+    unlock_sim(self);
+    PyBuffer_Release(&image);
+    if (result == CHECKPOINT_FAILED) {
+        PyErr_SetString(PyExc_ValueError, error);
+        return NULL;
+    }
+    // False: only L1 matched the configuration and was restored
+    return PyBool_FromLong(result == CHECKPOINT_RESTORED);
+}
+
+static PyObject *Simulator_get_position(SimulatorObject *self, void *closure) {
+    if (check_ready(self)) {
+        return NULL;
+    }
+    lock_sim(self);
+    uint64_t position = cachesim_position(self->sim);
+    unlock_sim(self);
+    return PyLong_FromUnsignedLongLong(position);
+}
+
+static PyMethodDef Simulator_methods[] = {
+    {"access", (PyCFunction)(void (*)(void))Simulator_access, METH_VARARGS | METH_KEYWORDS,
+     "access(addrs, writes=None)\n\nSimulate uint64 addresses in order; writes is an optional array of\n"
+     "bools or bytes, nonzero for a write (default: all reads)."},
+    {"access_packed", (PyCFunction)Simulator_access_packed, METH_O,
+     "access_packed(records)\n\nSimulate packed uint64 accesses, bit 63 set for a write (the raw\n"
+     "binary trace format)."},
+    {"warm", (PyCFunction)Simulator_warm, METH_O,
+     "warm(records)\n\nUpdate cache and prefetcher state from packed accesses, counting nothing."},
+    {"stats", (PyCFunction)Simulator_stats, METH_NOARGS,
+     "stats() -> dict\n\nThe statistics so far, ratios and AATs filled in."},
+    {"reset_stats", (PyCFunction)Simulator_reset_stats, METH_NOARGS,
+     "reset_stats()\n\nZero the counters, keeping the cache state."},
+    {"snapshot", (PyCFunction)Simulator_snapshot, METH_NOARGS,
+     "snapshot() -> bytes\n\nThe complete simulator state, as a cachesim checkpoint image."},
+    {"restore", (PyCFunction)Simulator_restore, METH_O,
+     "restore(image) -> bool\n\nRestore a snapshot() or `cachesim -x` checkpoint. False if only L1\n"
+     "matched the configuration, so only L1 was restored and the counters restart.\n"
+     "Raises ValueError, leaving the simulator as it was, on a corrupt image or\n"
+     "a different L1 configuration."},
+    {NULL, NULL, 0, NULL},
+};
+
+static PyGetSetDef Simulator_getset[] = {
+    {"position", (getter)Simulator_get_position, NULL, "Accesses simulated or warmed so far", NULL},
+    {NULL, NULL, NULL, NULL, NULL},
+};
+
+static PyTypeObject SimulatorType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cachesim.Simulator",
+    .tp_basicsize = sizeof(SimulatorObject),
+    .tp_dealloc = (destructor)Simulator_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Simulator(*, c1=10, b=6, s1=1, c2=15, s2=3, policy='lip', prefetch='none',\n"
+              "          markov_rows=0, l2=True)\n\n"
+              "One two-level cache simulation, configured like the cachesim flags\n"
+              "-c -b -s -C -S -P -F -r (l2=False is -D).",
+    .tp_methods = Simulator_methods,
+    .tp_getset = Simulator_getset,
+    .tp_init = (initproc)Simulator_init,
+    .tp_new = Simulator_new,
+};
+
+static struct PyModuleDef cachesim_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "cachesim",
+    .m_doc = "Two-level cache simulator (libcachesim.so)",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_cachesim(void) {
+    if (cachesim_api_version() != CACHESIM_API_VERSION) {
+        PyErr_SetString(PyExc_ImportError, "libcachesim.so does not match the API this module was built for");
+        return NULL;
+    }
+    if (PyType_Ready(&SimulatorType) < 0) {
+        return NULL;
+    }
+    PyObject *module = PyModule_Create(&cachesim_module);
+    if (!module) {
+        return NULL;
+    }
+    Py_INCREF(&SimulatorType);
+    if (PyModule_AddObject(module, "Simulator", (PyObject *)&SimulatorType) < 0) {
+        Py_DECREF(&SimulatorType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,293 @@
+#include "result_cache.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint64_t RESULT_MAGIC = 0x3154535243534943ULL; // "CISCRST1"
+static const uint64_t TRACES_MAGIC = 0x3152545343534943ULL; // "CISCSTR1"
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// Final avalanche (splitmix64)
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+TraceHasher::TraceHasher() : a(0x243F6A8885A308D3ULL), b(0x13198A2E03707344ULL), count(0) {
+}
+
+// Two independent multiply-rotate lanes, one word at a time
+void TraceHasher::update(const uint64_t *recs, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        a = rotl((a ^ recs[i]) * 0x9E3779B97F4A7C15ULL, 29);
+        b = rotl((b + recs[i]) * 0xC2B2AE3D27D4EB4FULL, 31) ^ a;
+    }
+    count += n;
+}
+
+TraceHash TraceHasher::digest() const {
+    TraceHash hash;
+    hash.h[0] = mix64(a ^ count);
+    hash.h[1] = mix64(b + rotl(count, 32) + hash.h[0]);
+    return hash;
+}
+
+TraceHash trace_hash(const std::vector<uint64_t> &recs) {
+    TraceHasher hasher;
+    hasher.update(recs.data(), recs.size());
+    return hasher.digest();
+}
+
+std::string trace_hash_str(const TraceHash &hash) {
+    char buf[33];
+    snprintf(buf, sizeof buf, "%016llx%016llx", (unsigned long long)hash.h[0], (unsigned long long)hash.h[1]);
+    return buf;
+}
+
+ResultCache::ResultCache() : results_fd(-1), traces_fd(-1), dropped(0) {
+}
+
+ResultCache::~ResultCache() {
+    if (results_fd >= 0) {
+        close(results_fd);
+    }
+    if (traces_fd >= 0) {
+        close(traces_fd);
+    }
+}
+
+// Fields that cannot change the results are zeroed: everything about a
+// disabled L2 but its block size
+void ResultCache::canonical_config(const sim_config_t &config, uint64_t *out) {
+    CacheSimulator::pack_config(config, out);
+    if (config.l2_config.disabled) {
+        uint64_t *l2 = out + SIM_CONFIG_WORDS / 2;
+        uint64_t b = l2[2];
+        memset(l2, 0, SIM_CONFIG_WORDS / 2 * sizeof *l2);
+        l2[0] = 1;
+        l2[2] = b;
+    }
+}
+
+uint64_t ResultCache::key(const TraceHash &trace, const uint64_t *config) {
+    uint64_t k = mix64(trace.h[0] ^ mix64(trace.h[1] ^ SIM_RESULTS_VERSION));
+    for (size_t i = 0; i < SIM_CONFIG_WORDS; i++) {
+        k = mix64(k ^ config[i]);
+    }
+    return k;
+}
+
+// Read every record of fd; records start with the word magic. A short
+// write (disk full, say) leaves part of a record that later appends follow,
+// so records are found by their magic rather than at multiples of
+// sizeof(T), and one overlapping the next record's magic is skipped.
+// Returns the number of partial records skipped.
+template <typename T>
+static size_t read_records(int fd, uint64_t magic, std::vector<T> &out) {
+    struct stat st;
+    if (fstat(fd, &st) || st.st_size <= 0) {
+        return 0;
+    }
+    std::vector<uint8_t> buf((size_t)st.st_size);
+    size_t got = 0;
+    while (got < buf.size()) {
+        ssize_t r = pread(fd, buf.data() + got, buf.size() - got, got);
+        if (r <= 0) {
+            break;
+        }
+        got += r;
+    }
+    const uint8_t *end = buf.data() + got;
+    const uint8_t *at = (const uint8_t *)memmem(buf.data(), got, &magic, sizeof magic);
+    size_t partial = 0;
+    while (at && (size_t)(end - at) >= sizeof(T)) {
+        const uint8_t *next = (const uint8_t *)memmem(at + 1, end - at - 1, &magic, sizeof magic);
+        if (next && (size_t)(next - at) < sizeof(T)) {
+            partial++;
+        } else {
+            T rec;
+            memcpy(&rec, at, sizeof rec);
+            out.push_back(rec);
+        }
+        at = next;
+    }
+    if (at) {
+        // cut short at the end of the file
+        partial++;
+    }
+    return partial;
+}
+
+static int open_store_file(const std::string &path, std::string *error) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0 && error) {
+        *error = path + ": " + strerror(errno);
+    }
+    return fd;
+}
+
+bool ResultCache::open(const std::string &path, std::string *error) {
+    dir = path;
+    if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        if (error) {
+            *error = dir + ": " + strerror(errno);
+        }
+        return false;
+    }
+    if ((results_fd = open_store_file(dir + "/results", error)) < 0
+        || (traces_fd = open_store_file(dir + "/traces", error)) < 0) {
+        return false;
+    }
+
+    std::vector<ResultRecord> all;
+    // invalidate() leaves partial records out of the rewritten file
+    dropped += read_records(results_fd, RESULT_MAGIC, all);
+    for (const ResultRecord &rec : all) {
+        if (rec.magic != RESULT_MAGIC || rec.version != SIM_RESULTS_VERSION
+            || rec.stats_size != sizeof(sim_stats_t)) {
+            dropped++;
+            continue;
+        }
+        uint64_t k = key(rec.trace, rec.config);
+        auto it = index.find(k);
+        if (it != index.end()) {
+            stored[it->second] = rec;
+            dropped++;
+        } else {
+            index.emplace(k, stored.size());
+            stored.push_back(rec);
+        }
+    }
+    read_records(traces_fd, TRACES_MAGIC, files);
+    return true;
+}
+
+bool ResultCache::lookup(const TraceHash &trace, const sim_config_t &config, sim_stats_t *stats) const {
+    uint64_t config_words[SIM_CONFIG_WORDS];
+    canonical_config(config, config_words);
+    auto it = index.find(key(trace, config_words));
+    if (it == index.end()) {
+        return false;
+    }
+    // the 64-bit key could collide; compare the whole key
+    const ResultRecord &rec = stored[it->second];
+    if (!(rec.trace == trace) || memcmp(rec.config, config_words, sizeof config_words)) {
+        return false;
+    }
+    *stats = rec.stats;
+    return true;
+}
+
+bool ResultCache::store(const TraceHash &trace, const sim_config_t &config, const sim_stats_t *stats) {
+    ResultRecord rec;
+    memset(&rec, 0, sizeof rec);
+    rec.magic = RESULT_MAGIC;
+    rec.version = SIM_RESULTS_VERSION;
+    rec.stats_size = sizeof *stats;
+    rec.trace = trace;
+    canonical_config(config, rec.config);
+    rec.stats = *stats;
+    if (write(results_fd, &rec, sizeof rec) != (ssize_t)sizeof rec) {
+        return false;
+    }
+    uint64_t k = key(trace, rec.config);
+    auto it = index.find(k);
+    if (it != index.end()) {
+        stored[it->second] = rec;
+    } else {
+        index.emplace(k, stored.size());
+        stored.push_back(rec);
+    }
+    return true;
+}
+
+bool ResultCache::file_id(int fd, FileId *id) {
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+    memset(id, 0, sizeof *id);
+    id->magic = TRACES_MAGIC;
+    id->dev = st.st_dev;
+    id->ino = st.st_ino;
+    id->size = st.st_size;
+    id->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    return true;
+}
+
+bool ResultCache::lookup_file(int fd, TraceHash *hash) const {
+    FileId id;
+    if (!file_id(fd, &id)) {
+        return false;
+    }
+    // newest entry wins; there are few enough files to scan
+    for (size_t i = files.size(); i-- > 0;) {
+        const FileId &f = files[i];
+        if (f.dev == id.dev && f.ino == id.ino && f.size == id.size && f.mtime_ns == id.mtime_ns) {
+            *hash = f.hash;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ResultCache::store_file(int fd, const TraceHash &hash) {
+    FileId id;
+    if (!file_id(fd, &id)) {
+        return;
+    }
+    id.hash = hash;
+    if (write(traces_fd, &id, sizeof id) == (ssize_t)sizeof id) {
+        files.push_back(id);
+    }
+}
+
+long ResultCache::invalidate(const std::function<bool(const ResultRecord &)> &pred) {
+    std::vector<ResultRecord> keep;
+    long n_dropped = (long)dropped;
+    for (const ResultRecord &rec : stored) {
+        if (pred(rec)) {
+            n_dropped++;
+        } else {
+            keep.push_back(rec);
+        }
+    }
+
+    // write a new results file and rename it over the old one
+    std::string tmp = dir + "/results.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    size_t bytes = keep.size() * sizeof(ResultRecord);
+    bool ok = bytes == 0 || write(fd, keep.data(), bytes) == (ssize_t)bytes;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), (dir + "/results").c_str())) {
+        unlink(tmp.c_str());
+        return -1;
+    }
+
+    close(results_fd);
+    results_fd = ::open((dir + "/results").c_str(), O_RDWR | O_APPEND);
+    stored.swap(keep);
+    index.clear();
+    for (size_t i = 0; i < stored.size(); i++) {
+        index.emplace(key(stored[i].trace, stored[i].config), i);
+    }
+    dropped = 0;
+    return n_dropped;
+}
+
+std::vector<ResultRecord> ResultCache::records() const {
+    return stored;
+}
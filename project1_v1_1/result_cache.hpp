@@ -0,0 +1,105 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cachesim.hpp"
+#include "cache_simulator.hpp"
+
+// Content hash of a trace: 128 bits over its packed records, so a text
+// trace, its binary conversion and a compressed copy all hash alike
+struct TraceHash {
+    uint64_t h[2];
+    bool operator==(const TraceHash &o) const { return h[0] == o.h[0] && h[1] == o.h[1]; }
+};
+
+class TraceHasher {
+public:
+    TraceHasher();
+    void update(const uint64_t *recs, size_t n);
+    TraceHash digest() const;
+
+private:
+    uint64_t a, b, count;
+};
+
+extern TraceHash trace_hash(const std::vector<uint64_t> &recs);
+// 32 hex digits
+extern std::string trace_hash_str(const TraceHash &hash);
+
+// One stored result. The key is the trace hash, the canonical config
+// encoding and the simulator version (SIM_RESULTS_VERSION).
+struct ResultRecord {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t stats_size;
+    TraceHash trace;
+    uint64_t config[SIM_CONFIG_WORDS];
+    sim_stats_t stats;
+};
+
+// Persistent, memoized simulation results in a directory:
+//
+//   results   append-only ResultRecords; a later record for the same key
+//             replaces an earlier one
+//   traces    append-only (device, inode, size, mtime) -> TraceHash
+//             entries, so an unchanged trace file is not hashed again
+//
+// open() reads both files into hash indexes, so lookups never touch the
+// disk. Each record goes out in a single O_APPEND write, so several
+// processes can add results to one store at the same time; invalidate()
+// rewrites the results file and should not race with writers. Records
+// start with a magic word and are found by it, so one cut short by a
+// failed write is skipped and every later record still reads.
+class ResultCache {
+public:
+    ResultCache();
+    ~ResultCache();
+
+    // Open the store in dir, creating it if needed. Returns false, with a
+    // message in *error, on failure.
+    bool open(const std::string &dir, std::string *error);
+
+    // Stats (as sim_finish() left them) for config on the trace, if stored
+    bool lookup(const TraceHash &trace, const sim_config_t &config, sim_stats_t *stats) const;
+    // Returns false if the record could not be written
+    bool store(const TraceHash &trace, const sim_config_t &config, const sim_stats_t *stats);
+
+    // Memoized content hash of the regular file behind fd
+    bool lookup_file(int fd, TraceHash *hash) const;
+    void store_file(int fd, const TraceHash &hash);
+
+    // Drop every record matching pred (and every record from another
+    // simulator version or superseded by a later one), then rewrite the
+    // results file. Returns the number of records dropped, or -1 on a
+    // write error.
+    long invalidate(const std::function<bool(const ResultRecord &)> &pred);
+    // Current records, one per key
+    std::vector<ResultRecord> records() const;
+
+private:
+    struct FileId {
+        uint64_t magic;
+        uint64_t dev, ino, size, mtime_ns;
+        TraceHash hash;
+    };
+
+    static uint64_t key(const TraceHash &trace, const uint64_t *config);
+    static void canonical_config(const sim_config_t &config, uint64_t *out);
+    static bool file_id(int fd, FileId *id);
+
+    std::string dir;
+    int results_fd;
+    int traces_fd;
+    std::vector<ResultRecord> stored;
+    // key -> index into stored
+    std::unordered_map<uint64_t, size_t> index;
+    std::vector<FileId> files;
+    uint64_t dropped;
+};
+
+#endif /* RESULT_CACHE_HPP */
@@ -4,22 +4,19 @@ OUTDIR="search"
 mkdir -p "$OUTDIR"
 HDR="trace,C1,B,S1,C2,S2,prefetch,r,L1_AAT,L1_HR,L1_MR,L2_AAT,L2_RHR,L2_RMR,PF_issued,PF_hits,PF_misses,L1_misses,L2_rhits,L2_rmisses,WB_L1"
 
+# Pick the columns out of cachesim --format=csv by their header names
+# (the sim_stats_t fields, see stats_output.cpp)
 get_stats() {
-    local o="$1"
-    local a1=$(echo "$o" | grep "L1 average access time" | awk '{print $NF}')
-    local h1=$(echo "$o" | grep "L1 hit ratio" | awk '{print $NF}')
-    local m1=$(echo "$o" | grep "L1 miss ratio" | awk '{print $NF}')
-    local a2=$(echo "$o" | grep "L2 average access time" | awk '{print $NF}')
-    local rh2=$(echo "$o" | grep "L2 read hit ratio" | awk '{print $NF}')
-    local rm2=$(echo "$o" | grep "L2 read miss ratio" | awk '{print $NF}')
-    local pfi=$(echo "$o" | grep "L2 prefetches issued" | awk '{print $NF}')
-    local pfh=$(echo "$o" | grep "L2 prefetch hits" | awk '{print $NF}')
-    local pfm=$(echo "$o" | grep "L2 prefetch misses" | awk '{print $NF}')
-    local ms1=$(echo "$o" | grep "L1 misses:" | awk '{print $NF}')
-    local rh=$(echo "$o" | grep "L2 read hits:" | awk '{print $NF}')
-    local rm=$(echo "$o" | grep "L2 read misses:" | awk '{print $NF}')
-    local wb=$(echo "$o" | grep "Write-backs from L1" | awk '{print $NF}')
-    echo "${a1},${h1},${m1},${a2},${rh2},${rm2},${pfi},${pfh},${pfm},${ms1},${rh},${rm},${wb}"
+    echo "$1" | awk -F, 'NR == 1 {
+        for (i = 1; i <= NF; i++) col[$i] = i
+    }
+    NR == 2 {
+        printf "%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%s,%s,%s,%s,%s,%s,%s\n",
+            $col["avg_access_time_l1"], $col["hit_ratio_l1"], $col["miss_ratio_l1"],
+            $col["avg_access_time_l2"], $col["read_hit_ratio_l2"], $col["read_miss_ratio_l2"],
+            $col["prefetches_issued_l2"], $col["prefetch_hits_l2"], $col["prefetch_misses_l2"],
+            $col["misses_l1"], $col["read_hits_l2"], $col["read_misses_l2"], $col["write_backs_l1"]
+    }'
 }
 
 echo "L1+L2 no-prefetch search"
@@ -36,7 +33,7 @@ for t in "${TRACES[@]}"; do
                     for S2 in 0 1 2 3 4 5; do
                         if (( S2 < S1 )); then continue; fi
                         if (( C2 - B - S2 < 0 )); then continue; fi
-                        o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 < "traces/${t}.trace" 2>/dev/null) || continue
+                        o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 --format=csv < "traces/${t}.trace" 2>/dev/null) || continue
                         s=$(get_stats "$o")
                         echo "${t},${C1},${B},${S1},${C2},${S2},none,0,${s}" >> "$F1"
                     done
@@ -61,7 +58,7 @@ for t in "${TRACES[@]}"; do
                     for S2 in 0 1 2 3 4 5; do
                         if (( S2 < S1 )); then continue; fi
                         if (( C2 - B - S2 < 0 )); then continue; fi
-                        o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F plus1 < "traces/${t}.trace" 2>/dev/null) || continue
+                        o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F plus1 --format=csv < "traces/${t}.trace" 2>/dev/null) || continue
                         s=$(get_stats "$o")
                         echo "${t},${C1},${B},${S1},${C2},${S2},plus1,0,${s}" >> "$F2"
                     done
@@ -88,7 +85,7 @@ for t in "${TRACES[@]}"; do
                         if (( S2 < S1 )); then continue; fi
                         if (( C2 - B - S2 < 0 )); then continue; fi
                         for r in "${RV[@]}"; do
-                            o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F markov -r $r < "traces/${t}.trace" 2>/dev/null) || continue
+                            o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F markov -r $r --format=csv < "traces/${t}.trace" 2>/dev/null) || continue
                             s=$(get_stats "$o")
                             echo "${t},${C1},${B},${S1},${C2},${S2},markov,${r},${s}" >> "$F3"
                         done
@@ -115,7 +112,7 @@ for t in "${TRACES[@]}"; do
                         if (( S2 < S1 )); then continue; fi
                         if (( C2 - B - S2 < 0 )); then continue; fi
                         for r in "${RV[@]}"; do
-                            o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F hybrid -r $r < "traces/${t}.trace" 2>/dev/null) || continue
+                            o=$(./cachesim -c $C1 -b $B -s $S1 -C $C2 -S $S2 -F hybrid -r $r --format=csv < "traces/${t}.trace" 2>/dev/null) || continue
                             s=$(get_stats "$o")
                             echo "${t},${C1},${B},${S1},${C2},${S2},hybrid,${r},${s}" >> "$F4"
                         done
@@ -0,0 +1,77 @@
+#include "stack_distance.hpp"
+
+static const uint64_t NO_BLOCK = UINT64_MAX;
+static const uint64_t MIN_SLOTS = 64;
+
+StackDistance::StackDistance()
+    : tree(MIN_SLOTS + 1, 0), slot_block(MIN_SLOTS, NO_BLOCK), next_slot(0) {
+}
+
+void StackDistance::add(uint64_t slot, int32_t delta) {
+    for (uint64_t i = slot + 1; i < tree.size(); i += i & (0 - i)) {
+        tree[i] += delta;
+    }
+}
+
+// live slots in [0, slot]
+uint64_t StackDistance::prefix(uint64_t slot) const {
+    int64_t sum = 0;
+    for (uint64_t i = slot + 1; i > 0; i -= i & (0 - i)) {
+        sum += tree[i];
+    }
+    return (uint64_t)sum;
+}
+
+// Renumber the live slots 0..live-1 in order and leave as many free slots
+// again, so compaction costs O(1) amortized per access
+void StackDistance::compact() {
+    uint64_t live = last_slot.size();
+    uint64_t n_slots = live * 2 > MIN_SLOTS ? live * 2 : MIN_SLOTS;
+    std::vector<uint64_t> blocks(n_slots, NO_BLOCK);
+    uint64_t k = 0;
+    for (uint64_t slot = 0; slot < next_slot; slot++) {
+        if (slot_block[slot] != NO_BLOCK) {
+            blocks[k] = slot_block[slot];
+            last_slot[blocks[k]] = k;
+            k++;
+        }
+    }
+    slot_block.swap(blocks);
+    next_slot = k;
+
+    // O(n) Fenwick build: seed the leaves, then push each node into its parent
+    tree.assign(n_slots + 1, 0);
+    for (uint64_t i = 1; i <= k; i++) {
+        tree[i] = 1;
+    }
+    for (uint64_t i = 1; i <= n_slots; i++) {
+        uint64_t parent = i + (i & (0 - i));
+        if (parent <= n_slots) {
+            tree[parent] += tree[i];
+        }
+    }
+}
+
+uint64_t StackDistance::access(uint64_t block) {
+    if (next_slot == slot_block.size()) {
+        compact();
+    }
+
+    uint64_t distance = COLD;
+    auto it = last_slot.find(block);
+    if (it != last_slot.end()) {
+        uint64_t slot = it->second;
+        // live slots after ours are the distinct blocks touched since
+        distance = last_slot.size() - prefix(slot);
+        add(slot, -1);
+        slot_block[slot] = NO_BLOCK;
+        it->second = next_slot;
+    } else {
+        last_slot.emplace(block, next_slot);
+    }
+
+    slot_block[next_slot] = block;
+    add(next_slot, 1);
+    next_slot++;
+    return distance;
+}
@@ -0,0 +1,42 @@
+#ifndef STACK_DISTANCE_HPP
+#define STACK_DISTANCE_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// LRU stack distances of a block reference stream (Mattson et al.). The
+// distance of a reference is the number of distinct other blocks touched
+// since the previous reference to the same block, so a fully associative
+// LRU cache of N blocks hits exactly the references with distance < N.
+//
+// Every block's most recent reference owns one time slot, and a Fenwick
+// tree over the slots counts the live ones, which makes each access
+// O(log n) in the number of distinct blocks. Slots are renumbered when
+// they run out, so memory stays proportional to the distinct blocks seen,
+// not to the trace length.
+class StackDistance {
+public:
+    static const uint64_t COLD = UINT64_MAX;
+
+    StackDistance();
+
+    // Reference block; returns its stack distance, or COLD on first touch
+    uint64_t access(uint64_t block);
+    // Number of distinct blocks referenced so far
+    uint64_t distinct() const { return last_slot.size(); }
+
+private:
+    void add(uint64_t slot, int32_t delta);
+    uint64_t prefix(uint64_t slot) const;
+    void compact();
+
+    std::unordered_map<uint64_t, uint64_t> last_slot;
+    // Fenwick tree, 1-based over slots [0, slot_block.size())
+    std::vector<int32_t> tree;
+    // owner of each slot, or NO_BLOCK once it has moved on
+    std::vector<uint64_t> slot_block;
+    uint64_t next_slot;
+};
+
+#endif /* STACK_DISTANCE_HPP */
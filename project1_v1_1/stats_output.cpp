@@ -0,0 +1,200 @@
+#include "stats_output.hpp"
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Every sim_stats_t field, in declaration order
+struct StatsField {
+    const char *name;
+    size_t offset;
+    bool is_double;
+};
+
+#define STATS_U64(f) {#f, offsetof(sim_stats_t, f), false}
+#define STATS_DBL(f) {#f, offsetof(sim_stats_t, f), true}
+static const StatsField STATS_FIELDS[] = {
+    STATS_U64(reads), STATS_U64(writes),
+    STATS_U64(accesses_l1), STATS_U64(hits_l1), STATS_U64(misses_l1),
+    STATS_DBL(hit_ratio_l1), STATS_DBL(miss_ratio_l1), STATS_DBL(avg_access_time_l1),
+    STATS_U64(write_backs_l1),
+    STATS_U64(reads_l2), STATS_U64(writes_l2), STATS_U64(read_hits_l2), STATS_U64(read_misses_l2),
+    STATS_DBL(read_hit_ratio_l2), STATS_DBL(read_miss_ratio_l2), STATS_DBL(avg_access_time_l2),
+    STATS_U64(prefetches_issued_l2), STATS_U64(prefetch_hits_l2), STATS_U64(prefetch_misses_l2),
+    STATS_U64(windows),
+};
+#undef STATS_U64
+#undef STATS_DBL
+
+// The pack_config() words, per level. Enum words are written by name, as
+// cachesim -P and -F take them; bin records keep the raw words.
+struct ConfigField {
+    const char *name;
+    const char *const *values;
+    size_t n_values;
+};
+
+static const char *const REPLACE_NAMES[] = {"mip", "lip"};
+static const char *const WRITE_NAMES[] = {"wbwa", "wtwna"};
+static const char *const PREFETCH_NAMES[] = {"none", "plus1", "markov", "hybrid"};
+
+#define CONFIG_NUM(f) {#f, NULL, 0}
+#define CONFIG_ENUM(f, names) {#f, names, sizeof names / sizeof *names}
+static const ConfigField CONFIG_FIELDS[SIM_CONFIG_WORDS / 2] = {
+    CONFIG_NUM(disabled), CONFIG_NUM(c), CONFIG_NUM(b), CONFIG_NUM(s),
+    CONFIG_ENUM(replace_policy, REPLACE_NAMES), CONFIG_ENUM(write_strat, WRITE_NAMES),
+    CONFIG_ENUM(prefetch_algorithm, PREFETCH_NAMES), CONFIG_NUM(n_markov_rows),
+};
+#undef CONFIG_NUM
+#undef CONFIG_ENUM
+
+int stats_parse_format(const char *name, stats_format_t *format) {
+    static const char *const names[] = {"text", "json", "csv", "bin"};
+    for (int i = 0; i < 4; i++) {
+        if (!strcmp(name, names[i])) {
+            *format = (stats_format_t)i;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void append_field(std::string &out, const sim_stats_t &stats, const StatsField &field) {
+    char buf[32];
+    const char *p = (const char *)&stats + field.offset;
+    if (field.is_double) {
+        double v;
+        memcpy(&v, p, sizeof v);
+        // round-trips exactly
+        snprintf(buf, sizeof buf, "%.17g", v);
+    } else {
+        uint64_t v;
+        memcpy(&v, p, sizeof v);
+        snprintf(buf, sizeof buf, "%" PRIu64, v);
+    }
+    out += buf;
+}
+
+// A name for enum words (quoted for JSON), else the number
+static void append_config(std::string &out, const ConfigField &field, uint64_t v, bool quote) {
+    if (v < field.n_values) {
+        out += quote ? std::string("\"") + field.values[v] + "\"" : field.values[v];
+    } else {
+        char buf[32];
+        snprintf(buf, sizeof buf, "%" PRIu64, v);
+        out += buf;
+    }
+}
+
+// Labels are written verbatim apart from what each format has to escape
+static std::string json_string(const char *s) {
+    std::string out = "\"";
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            out += '\\';
+            out += *s;
+        } else if ((unsigned char)*s < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", *s);
+            out += buf;
+        } else {
+            out += *s;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string csv_string(const char *s) {
+    if (!strpbrk(s, ",\"\r\n")) {
+        return s;
+    }
+    std::string out = "\"";
+    for (; *s; s++) {
+        if (*s == '"') {
+            out += '"';
+        }
+        out += *s;
+    }
+    return out + "\"";
+}
+
+std::string stats_format(stats_format_t format, const char *label, const sim_config_t &config,
+                         const sim_stats_t &stats, bool header) {
+    uint64_t words[SIM_CONFIG_WORDS];
+    CacheSimulator::pack_config(config, words);
+    std::string out;
+
+    if (format == STATS_FORMAT_JSON) {
+        out = "{\"label\":" + json_string(label);
+        for (int level = 0; level < 2; level++) {
+            out += level ? "},\"l2\":{" : ",\"l1\":{";
+            for (size_t i = 0; i < SIM_CONFIG_WORDS / 2; i++) {
+                out += std::string(i ? "," : "") + "\"" + CONFIG_FIELDS[i].name + "\":";
+                append_config(out, CONFIG_FIELDS[i], words[level * SIM_CONFIG_WORDS / 2 + i], true);
+            }
+        }
+        out += "},\"stats\":{";
+        for (size_t i = 0; i < sizeof STATS_FIELDS / sizeof *STATS_FIELDS; i++) {
+            out += std::string(i ? "," : "") + "\"" + STATS_FIELDS[i].name + "\":";
+            append_field(out, stats, STATS_FIELDS[i]);
+        }
+        out += "}}\n";
+    } else if (format == STATS_FORMAT_CSV) {
+        if (header) {
+            out = "label";
+            for (int level = 0; level < 2; level++) {
+                for (size_t i = 0; i < SIM_CONFIG_WORDS / 2; i++) {
+                    out += std::string(level ? ",l2_" : ",l1_") + CONFIG_FIELDS[i].name;
+                }
+            }
+            for (const StatsField &field : STATS_FIELDS) {
+                out += std::string(",") + field.name;
+            }
+            out += "\n";
+        }
+        out += csv_string(label);
+        for (size_t i = 0; i < SIM_CONFIG_WORDS; i++) {
+            out += ",";
+            append_config(out, CONFIG_FIELDS[i % (SIM_CONFIG_WORDS / 2)], words[i], false);
+        }
+        for (const StatsField &field : STATS_FIELDS) {
+            out += ",";
+            append_field(out, stats, field);
+        }
+        out += "\n";
+    } else if (format == STATS_FORMAT_BIN) {
+        stats_record_t rec;
+        memset(&rec, 0, sizeof rec);
+        memcpy(rec.magic, STATS_MAGIC, sizeof rec.magic);
+        rec.version = STATS_VERSION;
+        rec.stats_size = sizeof rec.stats;
+        strncpy(rec.label, label, sizeof rec.label - 1);
+        memcpy(rec.config, words, sizeof words);
+        rec.stats = stats;
+        out.assign((const char *)&rec, sizeof rec);
+    }
+    return out;
+}
+
+int stats_append(const char *path, stats_format_t format, const char *label, const sim_config_t &config,
+                 const sim_stats_t &stats) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        return 1;
+    }
+    struct stat st;
+    int ret = 1;
+    if (flock(fd, LOCK_EX) == 0 && fstat(fd, &st) == 0) {
+        std::string out = stats_format(format, label, config, stats, st.st_size == 0);
+        ret = write(fd, out.data(), out.size()) != (ssize_t)out.size();
+    }
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return ret;
+}
@@ -0,0 +1,47 @@
+#ifndef STATS_OUTPUT_HPP
+#define STATS_OUTPUT_HPP
+
+#include <stdint.h>
+#include <string>
+#include "cachesim.hpp"
+#include "cache_simulator.hpp"
+
+// Machine-readable results: the whole configuration and every sim_stats_t
+// field, tagged with a free-form label (the trace name, say)
+typedef enum stats_format {
+    STATS_FORMAT_TEXT,
+    // one JSON object per line
+    STATS_FORMAT_JSON,
+    // a header line, then one row per result
+    STATS_FORMAT_CSV,
+    // one stats_record_t per result
+    STATS_FORMAT_BIN
+} stats_format_t;
+
+// Binary records are fixed-size, host byte order
+static const char STATS_MAGIC[8] = {'C', 'S', 'I', 'M', 'S', 'T', 'A', 'T'};
+static const uint32_t STATS_VERSION = 1;
+typedef struct stats_record {
+    char magic[8];
+    uint32_t version;
+    uint32_t stats_size;
+    // NUL-padded, truncated to fit
+    char label[48];
+    // CacheSimulator::pack_config()
+    uint64_t config[SIM_CONFIG_WORDS];
+    sim_stats_t stats;
+} stats_record_t;
+
+// "text", "json", "csv" or "bin"; returns 0 on success
+extern int stats_parse_format(const char *name, stats_format_t *format);
+// One result in the given (non-text) format. header adds the CSV header.
+extern std::string stats_format(stats_format_t format, const char *label, const sim_config_t &config,
+                                const sim_stats_t &stats, bool header);
+// Append one result to path, creating it if needed. Many processes can
+// append to one file at once: each result is written with a single write()
+// under an exclusive lock, and a CSV header only goes into an empty file.
+// Returns 0 on success, with errno set otherwise.
+extern int stats_append(const char *path, stats_format_t format, const char *label, const sim_config_t &config,
+                        const sim_stats_t &stats);
+
+#endif /* STATS_OUTPUT_HPP */
@@ -0,0 +1,98 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(unsigned n_threads) {
+    if (n_threads == 0) {
+        n_threads = std::thread::hardware_concurrency();
+    }
+    if (n_threads == 0) {
+        n_threads = 1;
+    }
+    for (unsigned i = 0; i < n_threads; i++) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (unsigned i = 0; i < n_threads; i++) {
+        threads.push_back(std::thread(&ThreadPool::run, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        // counted before it becomes visible, so queued never undercounts
+        std::lock_guard<std::mutex> guard(state_lock);
+        Worker &target = *workers[next_worker];
+        next_worker = (next_worker + 1) % workers.size();
+        pending++;
+        queued++;
+        std::lock_guard<std::mutex> target_guard(target.lock);
+        target.tasks.push_back(std::move(task));
+    }
+    work_cv.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> guard(state_lock);
+    done_cv.wait(guard, [this] { return pending == 0; });
+}
+
+bool ThreadPool::take_task(unsigned self, std::function<void()> &task) {
+    {
+        Worker &own = *workers[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned i = 1; i < workers.size(); i++) {
+        Worker &victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run(unsigned self) {
+    std::function<void()> task;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            work_cv.wait(guard, [this] { return queued > 0 || stopping; });
+            if (queued == 0 && stopping) {
+                return;
+            }
+        }
+        if (!take_task(self, task)) {
+            // someone else got there first
+            std::this_thread::yield();
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            queued--;
+        }
+        task();
+        task = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            if (--pending == 0) {
+                done_cv.notify_all();
+            }
+        }
+    }
+}
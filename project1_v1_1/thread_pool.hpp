@@ -0,0 +1,50 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool. Every worker owns a deque: it runs
+// its own tasks newest-first and, once that runs dry, steals the oldest
+// task from another worker. Tasks are spread over the deques round-robin.
+class ThreadPool {
+public:
+    // n_threads == 0 means one thread per hardware thread
+    explicit ThreadPool(unsigned n_threads = 0);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    // Block until every task submitted so far has finished
+    void wait();
+
+    unsigned size() const { return (unsigned)threads.size(); }
+
+private:
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take_task(unsigned self, std::function<void()> &task);
+    void run(unsigned self);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+
+    std::mutex state_lock;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    // tasks sitting in some deque / submitted but not yet finished
+    uint64_t queued = 0;
+    uint64_t pending = 0;
+    unsigned next_worker = 0;
+    bool stopping = false;
+};
+
+#endif /* THREAD_POOL_HPP */
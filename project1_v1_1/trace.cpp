@@ -0,0 +1,711 @@
+#include "trace.hpp"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TRACE_X86 1
+#endif
+
+// varint bytes are staged here and flushed with one fwrite
+static const size_t WRITER_BUF_SIZE = 1 << 16;
+// block size for input that cannot be mapped
+static const size_t READER_BUF_SIZE = 1 << 20;
+
+int trace_map_fd(int fd, trace_mapping_t *mapping) {
+    struct stat st;
+    if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        return 1;
+    }
+    mapping->size = (size_t)st.st_size;
+    if (mapping->size == 0) {
+        // mmap() rejects empty mappings, but an empty trace is fine
+        mapping->data = NULL;
+        return 0;
+    }
+    void *p = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+        return 1;
+    }
+    madvise(p, mapping->size, MADV_SEQUENTIAL);
+    mapping->data = (const uint8_t *)p;
+    return 0;
+}
+
+void trace_unmap(trace_mapping_t *mapping) {
+    if (mapping->data) {
+        munmap((void *)mapping->data, mapping->size);
+    }
+    mapping->data = NULL;
+    mapping->size = 0;
+}
+
+bool trace_is_binary(const uint8_t *data, size_t size) {
+    trace_header_t hdr;
+    if (size < sizeof hdr) {
+        return false;
+    }
+    memcpy(&hdr, data, sizeof hdr);
+    return !memcmp(hdr.magic, TRACE_MAGIC, sizeof hdr.magic) && hdr.version == TRACE_VERSION;
+}
+
+static int write_header(trace_writer_t *writer) {
+    trace_header_t hdr;
+    memset(&hdr, 0, sizeof hdr);
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof hdr.magic);
+    hdr.version = TRACE_VERSION;
+    hdr.flags = writer->flags;
+    hdr.n_records = writer->n_records;
+    return fwrite(&hdr, sizeof hdr, 1, writer->out) != 1;
+}
+
+static int flush_buf(trace_writer_t *writer) {
+    if (writer->buf_used && fwrite(writer->buf, 1, writer->buf_used, writer->out) != writer->buf_used) {
+        return 1;
+    }
+    writer->buf_used = 0;
+    return 0;
+}
+
+int trace_writer_open(trace_writer_t *writer, FILE *out, uint32_t flags) {
+    writer->out = out;
+    writer->flags = flags;
+    writer->n_records = 0;
+    writer->prev_addr = 0;
+    writer->buf_used = 0;
+    writer->counted = false;
+    writer->n_counted = 0;
+    writer->buf = (uint8_t *)malloc(WRITER_BUF_SIZE);
+    if (!writer->buf) {
+        return 1;
+    }
+    // placeholder; the real count is patched in by trace_writer_close()
+    return write_header(writer);
+}
+
+int trace_writer_open_counted(trace_writer_t *writer, FILE *out, uint32_t flags, uint64_t n_records) {
+    writer->out = out;
+    writer->flags = flags;
+    writer->n_records = n_records;
+    writer->prev_addr = 0;
+    writer->buf_used = 0;
+    writer->counted = true;
+    writer->n_counted = n_records;
+    writer->buf = (uint8_t *)malloc(WRITER_BUF_SIZE);
+    if (!writer->buf) {
+        return 1;
+    }
+    int ret = write_header(writer);
+    writer->n_records = 0;
+    return ret;
+}
+
+// One delta record at p; returns the end
+static inline uint8_t *put_delta(uint8_t *p, uint64_t prev_addr, uint64_t addr, bool is_write) {
+    // sign-extend the 63-bit difference, then zigzag it so small
+    // negative strides also get short varints
+    int64_t delta = (int64_t)(((addr - prev_addr) & TRACE_ADDR_MASK) << 1) >> 1;
+    uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    uint64_t v = (zz << 1) | (is_write ? 1 : 0);
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+int trace_writer_append(trace_writer_t *writer, char rw, uint64_t addr) {
+    if (addr & TRACE_WRITE_BIT) {
+        // bit 63 is the write flag, so such addresses cannot be represented
+        return 1;
+    }
+    if (writer->buf_used + 10 > WRITER_BUF_SIZE && flush_buf(writer)) {
+        return 1;
+    }
+    uint8_t *p = writer->buf + writer->buf_used;
+
+    if (!(writer->flags & TRACE_FLAG_DELTA)) {
+        uint64_t rec = trace_pack(rw, addr);
+        memcpy(p, &rec, sizeof rec);
+        writer->buf_used += sizeof rec;
+    } else {
+        p = put_delta(p, writer->prev_addr, addr, rw == WRITE);
+        writer->buf_used = p - writer->buf;
+        writer->prev_addr = addr;
+    }
+    writer->n_records++;
+    return 0;
+}
+
+int trace_writer_append_packed(trace_writer_t *writer, const uint64_t *recs, size_t n) {
+    if (!(writer->flags & TRACE_FLAG_DELTA)) {
+        // already in the file format; skip the buffer
+        if (flush_buf(writer) || fwrite(recs, sizeof *recs, n, writer->out) != n) {
+            return 1;
+        }
+        writer->n_records += n;
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (writer->buf_used + 10 > WRITER_BUF_SIZE && flush_buf(writer)) {
+            return 1;
+        }
+        uint64_t addr = recs[i] & TRACE_ADDR_MASK;
+        uint8_t *p = put_delta(writer->buf + writer->buf_used, writer->prev_addr, addr,
+                               (recs[i] & TRACE_WRITE_BIT) != 0);
+        writer->buf_used = p - writer->buf;
+        writer->prev_addr = addr;
+    }
+    writer->n_records += n;
+    return 0;
+}
+
+int trace_writer_close(trace_writer_t *writer) {
+    int ret = flush_buf(writer);
+    free(writer->buf);
+    writer->buf = NULL;
+    if (writer->counted) {
+        return ret || writer->n_records != writer->n_counted || fflush(writer->out);
+    }
+    if (!ret) {
+        ret = fseek(writer->out, 0, SEEK_SET) || write_header(writer) || fflush(writer->out);
+    }
+    return ret;
+}
+
+/* Text parsing */
+
+static inline int hex_digit(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Splits the line [s, e) into its rw character and the span holding the
+// address digits, with trailing whitespace trimmed. Returns false if the
+// line does not look like "X 0x...".
+static inline bool split_line(const char *s, const char *e, char *rw,
+                              const char **digits, const char **digits_end) {
+    if (s == e) {
+        return false;
+    }
+    *rw = *s++;
+    while (s < e && (*s == ' ' || *s == '\t')) {
+        s++;
+    }
+    if (e - s < 3 || s[0] != '0' || s[1] != 'x') {
+        return false;
+    }
+    while (e > s + 2 && (e[-1] == '\r' || e[-1] == ' ' || e[-1] == '\t')) {
+        e--;
+    }
+    *digits = s + 2;
+    *digits_end = e;
+    return true;
+}
+
+// Same rules as %x: take the leading run of hex digits, need at least one.
+// A value wider than 64 bits comes back with bit 63 set, so it is rejected
+// like any other address that does not fit in an access_t.
+static inline bool hex_scalar(const char *d, const char *de, uint64_t *value) {
+    uint64_t v = 0, lost = 0;
+    const char *p = d;
+    for (; p < de; p++) {
+        int x = hex_digit((uint8_t)*p);
+        if (x < 0) {
+            break;
+        }
+        lost |= v >> 60;
+        v = (v << 4) | (uint64_t)x;
+    }
+    *value = lost ? v | TRACE_WRITE_BIT : v;
+    return p != d;
+}
+
+// The line parsers OR every address into *wide; bit 63 set there means an
+// address trace_pack() would have truncated
+static inline bool parse_line_scalar(const char *s, const char *e, uint64_t *rec, uint64_t *wide) {
+    char rw;
+    const char *d, *de;
+    uint64_t addr;
+    if (!split_line(s, e, &rw, &d, &de) || !hex_scalar(d, de, &addr)) {
+        return false;
+    }
+    *wide |= addr;
+    *rec = trace_pack(rw, addr);
+    return true;
+}
+
+static size_t parse_text_scalar(const char *text, size_t n, bool at_eof,
+                                uint64_t *out, size_t max_out, size_t *n_out, bool *bad_addr) {
+    const char *line = text;
+    const char *end = text + n;
+    size_t k = 0;
+    uint64_t wide = 0;
+    while (k < max_out) {
+        const char *nl = (const char *)memchr(line, '\n', end - line);
+        if (!nl) {
+            if (at_eof && line < end) {
+                k += parse_line_scalar(line, end, &out[k], &wide);
+                line = end;
+            }
+            break;
+        }
+        k += parse_line_scalar(line, nl, &out[k], &wide);
+        line = nl + 1;
+    }
+    *n_out = k;
+    *bad_addr = (wide & TRACE_WRITE_BIT) != 0;
+    return line - text;
+}
+
+#ifdef TRACE_X86
+// Right-aligned window masks: mask_tail + n keeps the last n of 16 bytes
+static const uint8_t mask_tail[32] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
+// Decodes up to 16 hex digits in one go: load the 16 bytes that end at the
+// last digit, turn ASCII into nibbles, zero the bytes in front of the
+// digits, then fold nibble pairs into bytes with pmaddubsw and byte-swap.
+// Anything unusual (too many digits, a line too close to the start of the
+// buffer, non-hex characters) goes to the scalar path. Forced inline so the
+// AVX2 caller gets VEX-encoded copies instead of paying SSE/AVX transitions.
+__attribute__((target("ssse3"), always_inline))
+static inline bool parse_line_simd(const char *base, const char *s, const char *e, uint64_t *rec,
+                                   uint64_t *wide) {
+    char rw;
+    const char *d, *de;
+    uint64_t addr;
+    if (!split_line(s, e, &rw, &d, &de)) {
+        return false;
+    }
+    ptrdiff_t n = de - d;
+    if (n < 1 || n > 16 || de - 16 < base) {
+        if (!hex_scalar(d, de, &addr)) {
+            return false;
+        }
+        *wide |= addr;
+        *rec = trace_pack(rw, addr);
+        return true;
+    }
+
+    __m128i c = _mm_loadu_si128((const __m128i *)(de - 16));
+    __m128i keep = _mm_loadu_si128((const __m128i *)(mask_tail + n));
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                     _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                     _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    __m128i valid = _mm_or_si128(is_digit, is_alpha);
+    if ((_mm_movemask_epi8(_mm_and_si128(valid, keep)) ^ _mm_movemask_epi8(keep)) != 0) {
+        if (!hex_scalar(d, de, &addr)) {
+            return false;
+        }
+        *wide |= addr;
+        *rec = trace_pack(rw, addr);
+        return true;
+    }
+
+    // '0'-'9' -> c & 0xf, 'a'-'f'/'A'-'F' -> (c & 0xf) + 9
+    __m128i nib = _mm_and_si128(c, _mm_set1_epi8(0x0f));
+    nib = _mm_add_epi8(nib, _mm_andnot_si128(is_digit, _mm_set1_epi8(9)));
+    nib = _mm_and_si128(nib, keep);
+    __m128i bytes = _mm_maddubs_epi16(nib, _mm_set1_epi16(0x0110));
+    bytes = _mm_packus_epi16(bytes, bytes);
+    addr = __builtin_bswap64((uint64_t)_mm_cvtsi128_si64(bytes));
+    *wide |= addr;
+    *rec = trace_pack(rw, addr);
+    return true;
+}
+
+// The SIMD variants only differ in how wide the newline scan is; both
+// finish the last partial chunk with memchr.
+#define PARSE_TEXT_SIMD(VEC, LOAD, CMPEQ, SET1, MOVEMASK)                       \
+    const char *line = text;                                                   \
+    const char *end = text + n;                                                \
+    const char *p = text;                                                      \
+    size_t k = 0;                                                              \
+    uint64_t wide = 0;                                                         \
+    while (end - p >= (ptrdiff_t)sizeof(VEC) && k < max_out) {                 \
+        uint32_t m = (uint32_t)MOVEMASK(CMPEQ(LOAD((const VEC *)p), SET1('\n'))); \
+        while (m && k < max_out) {                                             \
+            const char *nl = p + __builtin_ctz(m);                             \
+            m &= m - 1;                                                        \
+            k += parse_line_simd(text, line, nl, &out[k], &wide);              \
+            line = nl + 1;                                                     \
+        }                                                                      \
+        if (m) {                                                               \
+            break;                                                             \
+        }                                                                      \
+        p += sizeof(VEC);                                                      \
+    }                                                                          \
+    while (k < max_out) {                                                      \
+        const char *nl = (const char *)memchr(line, '\n', end - line);         \
+        if (!nl) {                                                             \
+            if (at_eof && line < end) {                                        \
+                k += parse_line_simd(text, line, end, &out[k], &wide);         \
+                line = end;                                                    \
+            }                                                                  \
+            break;                                                             \
+        }                                                                      \
+        k += parse_line_simd(text, line, nl, &out[k], &wide);                  \
+        line = nl + 1;                                                         \
+    }                                                                          \
+    *n_out = k;                                                                \
+    *bad_addr = (wide & TRACE_WRITE_BIT) != 0;                                 \
+    return line - text;
+
+__attribute__((target("avx2")))
+static size_t parse_text_avx2(const char *text, size_t n, bool at_eof,
+                              uint64_t *out, size_t max_out, size_t *n_out, bool *bad_addr) {
+    PARSE_TEXT_SIMD(__m256i, _mm256_loadu_si256, _mm256_cmpeq_epi8, _mm256_set1_epi8, _mm256_movemask_epi8)
+}
+
+__attribute__((target("sse4.2")))
+static size_t parse_text_sse42(const char *text, size_t n, bool at_eof,
+                               uint64_t *out, size_t max_out, size_t *n_out, bool *bad_addr) {
+    PARSE_TEXT_SIMD(__m128i, _mm_loadu_si128, _mm_cmpeq_epi8, _mm_set1_epi8, _mm_movemask_epi8)
+}
+#endif
+
+typedef size_t (*parse_text_fn)(const char *, size_t, bool, uint64_t *, size_t, size_t *, bool *);
+
+static parse_text_fn pick_parse_text(const char **name) {
+#ifdef TRACE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return parse_text_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        *name = "sse4.2";
+        return parse_text_sse42;
+    }
+#endif
+    *name = "scalar";
+    return parse_text_scalar;
+}
+
+static const char *parse_text_name;
+static const parse_text_fn parse_text_impl = pick_parse_text(&parse_text_name);
+
+size_t trace_parse_text(const char *text, size_t n, bool at_eof,
+                        uint64_t *out, size_t max_out, size_t *n_out, bool *bad_addr) {
+    return parse_text_impl(text, n, at_eof, out, max_out, n_out, bad_addr);
+}
+
+const char *trace_parse_text_impl(void) {
+    return parse_text_name;
+}
+
+/* Reader */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Decompress up to cap bytes into dst, reading more compressed input as
+// needed. Returns the number of bytes made; 0 at the end of the input or
+// on error (reader->error is set, including for a truncated stream).
+static size_t reader_inflate(trace_reader_t *reader, uint8_t *dst, size_t cap) {
+    double start = now();
+    size_t made = 0;
+    while (!made) {
+        if (reader->zoff == reader->zlen && !reader->zeof) {
+            ssize_t got = read(reader->fd, reader->zbuf, READER_BUF_SIZE);
+            if (got <= 0) {
+                reader->zeof = true;
+            } else {
+                reader->zlen = (size_t)got;
+                reader->zoff = 0;
+            }
+        }
+        size_t used;
+        if (trace_decoder_run(reader->decoder, reader->zdata + reader->zoff, reader->zlen - reader->zoff,
+                              &used, dst, cap, &made)) {
+            reader->error = true;
+            break;
+        }
+        reader->zoff += used;
+        reader->bytes_compressed += used;
+        if (!made && reader->zoff == reader->zlen && reader->zeof) {
+            if (!trace_decoder_at_end(reader->decoder)) {
+                reader->error = true;
+            }
+            break;
+        }
+        if (!made && !used && reader->zoff < reader->zlen) {
+            // the decoder is stuck on input it will not take
+            reader->error = true;
+            break;
+        }
+    }
+    reader->decompress_secs += now() - start;
+    return made;
+}
+
+// Make at least `want` unread bytes available if the input has them
+static void reader_fill(trace_reader_t *reader, size_t want) {
+    if ((reader->mapped && !reader->decoder) || reader->eof || reader->len - reader->off >= want) {
+        return;
+    }
+    size_t left = reader->len - reader->off;
+    memmove(reader->buf, reader->buf + reader->off, left);
+    reader->off = 0;
+    reader->len = left;
+    while (reader->len < READER_BUF_SIZE && reader->len < want) {
+        ssize_t got = reader->decoder
+            ? (ssize_t)reader_inflate(reader, reader->buf + reader->len, READER_BUF_SIZE - reader->len)
+            : read(reader->fd, reader->buf + reader->len, READER_BUF_SIZE - reader->len);
+        if (got <= 0) {
+            reader->eof = true;
+            break;
+        }
+        reader->len += (size_t)got;
+    }
+}
+
+int trace_reader_open(trace_reader_t *reader, int fd) {
+    memset(reader, 0, sizeof *reader);
+    reader->fd = fd;
+    reader->recs = (uint64_t *)malloc(TRACE_BATCH * sizeof(uint64_t));
+    if (!reader->recs) {
+        return 1;
+    }
+
+    if (!trace_map_fd(fd, &reader->mapping)) {
+        reader->mapped = true;
+        reader->window = reader->mapping.data;
+        reader->len = reader->mapping.size;
+        reader->eof = true;
+    } else {
+        reader->buf = (uint8_t *)malloc(READER_BUF_SIZE);
+        if (!reader->buf) {
+            trace_reader_close(reader);
+            return 1;
+        }
+        reader->window = reader->buf;
+        reader_fill(reader, sizeof(trace_header_t));
+    }
+
+    reader->codec = trace_detect_codec(reader->window, reader->len);
+    if (reader->codec != TRACE_CODEC_NONE) {
+        // what was read so far is compressed input; decompress into a fresh
+        // buffer from here on
+        reader->decoder = trace_decoder_open(reader->codec);
+        if (!reader->decoder) {
+            trace_reader_close(reader);
+            return 1;
+        }
+        if (reader->mapped) {
+            reader->zdata = reader->mapping.data;
+            reader->buf = (uint8_t *)malloc(READER_BUF_SIZE);
+        } else {
+            reader->zbuf = reader->buf;
+            reader->zdata = reader->zbuf;
+            reader->buf = (uint8_t *)malloc(READER_BUF_SIZE);
+        }
+        reader->zlen = reader->len;
+        reader->zeof = reader->eof;
+        if (!reader->buf) {
+            trace_reader_close(reader);
+            return 1;
+        }
+        reader->window = reader->buf;
+        reader->len = 0;
+        reader->off = 0;
+        reader->eof = false;
+        reader_fill(reader, sizeof(trace_header_t));
+    }
+
+    if (trace_is_binary(reader->window + reader->off, reader->len - reader->off)) {
+        trace_header_t hdr;
+        memcpy(&hdr, reader->window + reader->off, sizeof hdr);
+        reader->binary = true;
+        reader->flags = hdr.flags;
+        reader->n_left = hdr.n_records;
+        reader->off += sizeof hdr;
+        reader->bytes_in += sizeof hdr;
+    }
+    return 0;
+}
+
+static const uint64_t *next_raw(trace_reader_t *reader, size_t *n) {
+    reader_fill(reader, TRACE_BATCH * sizeof(uint64_t));
+    size_t avail = (reader->len - reader->off) / sizeof(uint64_t);
+    size_t k = avail < TRACE_BATCH ? avail : TRACE_BATCH;
+    if (k > reader->n_left) {
+        k = (size_t)reader->n_left;
+    }
+    if (k == 0) {
+        reader->error = true;
+        return NULL;
+    }
+    // offsets stay multiples of 8 past the 32-byte header, so this is aligned
+    const uint64_t *recs = (const uint64_t *)(reader->window + reader->off);
+    reader->off += k * sizeof(uint64_t);
+    reader->bytes_in += k * sizeof(uint64_t);
+    reader->n_left -= k;
+    *n = k;
+    return recs;
+}
+
+static const uint64_t *next_delta(trace_reader_t *reader, size_t *n) {
+    // a varint is at most 10 bytes
+    reader_fill(reader, TRACE_BATCH * 10);
+    const uint8_t *p = reader->window + reader->off;
+    const uint8_t *end = reader->window + reader->len;
+    uint64_t addr = reader->prev_addr;
+    size_t k = 0;
+    while (k < TRACE_BATCH && k < reader->n_left) {
+        uint64_t v = 0;
+        unsigned shift = 0;
+        const uint8_t *q = p;
+        bool complete = false;
+        while (q < end && shift <= 63) {
+            uint8_t byte = *q++;
+            v |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                complete = true;
+                break;
+            }
+            shift += 7;
+        }
+        if (!complete) {
+            // cut off by the end of the window; the next call refills it
+            break;
+        }
+        p = q;
+        uint64_t zz = v >> 1;
+        uint64_t delta = (zz >> 1) ^ (0 - (zz & 1));
+        addr = (addr + delta) & TRACE_ADDR_MASK;
+        reader->recs[k++] = addr | ((v & 1) ? TRACE_WRITE_BIT : 0);
+    }
+    if (k == 0) {
+        reader->error = true;
+        return NULL;
+    }
+    reader->bytes_in += p - (reader->window + reader->off);
+    reader->off = p - reader->window;
+    reader->prev_addr = addr;
+    reader->n_left -= k;
+    *n = k;
+    return reader->recs;
+}
+
+static const uint64_t *next_text(trace_reader_t *reader, size_t *n) {
+    for (;;) {
+        if (reader->eof && reader->off == reader->len) {
+            return NULL;
+        }
+        size_t k = 0;
+        bool bad_addr = false;
+        size_t used = trace_parse_text((const char *)reader->window + reader->off,
+                                       reader->len - reader->off, reader->eof,
+                                       reader->recs, TRACE_BATCH, &k, &bad_addr);
+        if (bad_addr) {
+            reader->error = true;
+            reader->bad_addr = true;
+            return NULL;
+        }
+        reader->off += used;
+        reader->bytes_in += used;
+        if (k) {
+            *n = k;
+            return reader->recs;
+        }
+        if (reader->eof) {
+            return NULL;
+        }
+        if (!used && reader->off == 0 && reader->len == READER_BUF_SIZE) {
+            // a single line longer than the whole buffer is not a trace line
+            reader->off = reader->len;
+        }
+        reader_fill(reader, READER_BUF_SIZE);
+    }
+}
+
+const uint64_t *trace_reader_next(trace_reader_t *reader, size_t *n) {
+    if (reader->error) {
+        return NULL;
+    }
+    if (!reader->binary) {
+        return next_text(reader, n);
+    }
+    if (reader->n_left == 0) {
+        return NULL;
+    }
+    return (reader->flags & TRACE_FLAG_DELTA) ? next_delta(reader, n) : next_raw(reader, n);
+}
+
+void trace_reader_close(trace_reader_t *reader) {
+    if (reader->mapped) {
+        trace_unmap(&reader->mapping);
+        reader->mapped = false;
+    }
+    trace_decoder_close(reader->decoder);
+    free(reader->buf);
+    free(reader->zbuf);
+    free(reader->recs);
+    reader->decoder = NULL;
+    reader->buf = NULL;
+    reader->zbuf = NULL;
+    reader->recs = NULL;
+}
+
+const char *trace_reader_strerror(const trace_reader_t *reader) {
+    static char msg[96];
+    if (reader->codec != TRACE_CODEC_NONE && !trace_codec_supported(reader->codec)) {
+        snprintf(msg, sizeof msg, "%s-compressed trace, but cachesim was built without %s support",
+                 trace_codec_name(reader->codec), trace_codec_name(reader->codec));
+        return msg;
+    }
+    if (!reader->error) {
+        return "Cannot allocate trace buffers";
+    }
+    if (reader->bad_addr) {
+        // like trace_writer_append(): bit 63 of a packed record is the write flag
+        return "Text trace has an address that does not fit in 63 bits";
+    }
+    if (reader->codec != TRACE_CODEC_NONE) {
+        snprintf(msg, sizeof msg, "Truncated or corrupt %s stream", trace_codec_name(reader->codec));
+        return msg;
+    }
+    return "Truncated or corrupt binary trace";
+}
+
+int trace_load(const char *path, std::vector<uint64_t> &recs) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    trace_reader_t reader;
+    if (trace_reader_open(&reader, fd)) {
+        close(fd);
+        return 1;
+    }
+    recs.clear();
+    if (reader.binary) {
+        recs.reserve(reader.n_left);
+    }
+    const uint64_t *batch;
+    size_t n;
+    while ((batch = trace_reader_next(&reader, &n))) {
+        recs.insert(recs.end(), batch, batch + n);
+    }
+    int ret = reader.error;
+    trace_reader_close(&reader);
+    close(fd);
+    return ret;
+}
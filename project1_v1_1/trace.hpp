@@ -0,0 +1,157 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "cachesim.hpp"
+#include "trace_compress.hpp"
+
+// Binary trace format
+// -------------------
+// A 32-byte trace_header_t followed by the records. Two record encodings:
+//
+// Raw (flags == 0): n_records little-endian uint64_t words. Bit 63 is set
+// for a write, bits 0-62 hold the address. The header keeps the records
+// 8-byte aligned, so a mapped file can be walked in place.
+//
+// Delta (TRACE_FLAG_DELTA): one LEB128 varint per record holding
+// (zigzag(addr - prev_addr) << 1) | is_write, with the difference taken
+// modulo 2^63 and prev_addr starting at 0. Sequential and strided traces
+// shrink to 1-2 bytes per record.
+static const char TRACE_MAGIC[8] = {'C', 'S', 'I', 'M', 'T', 'R', 'C', '\0'};
+static const uint32_t TRACE_VERSION = 1;
+static const uint32_t TRACE_FLAG_DELTA = 1u << 0;
+
+// packed records are access_t values (cachesim.hpp)
+static const uint64_t TRACE_WRITE_BIT = ACCESS_WRITE_BIT;
+static const uint64_t TRACE_ADDR_MASK = ACCESS_ADDR_MASK;
+
+typedef struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t n_records;
+    uint64_t reserved;
+} trace_header_t;
+
+static inline uint64_t trace_pack(char rw, uint64_t addr) {
+    return (addr & TRACE_ADDR_MASK) | (rw == WRITE ? TRACE_WRITE_BIT : 0);
+}
+static inline char trace_rw(uint64_t rec) {
+    return (rec & TRACE_WRITE_BIT) ? WRITE : READ;
+}
+static inline uint64_t trace_addr(uint64_t rec) {
+    return rec & TRACE_ADDR_MASK;
+}
+
+// A whole input file. Regular files are mmap()ed; data is read-only.
+typedef struct trace_mapping {
+    const uint8_t *data;
+    size_t size;
+} trace_mapping_t;
+
+// Map the regular file behind fd. Returns 0 on success, nonzero if fd is
+// not a regular file or cannot be mapped (a pipe, for instance).
+extern int trace_map_fd(int fd, trace_mapping_t *mapping);
+extern void trace_unmap(trace_mapping_t *mapping);
+
+// Returns true if data starts with a binary trace header we understand.
+extern bool trace_is_binary(const uint8_t *data, size_t size);
+
+// Incremental writer used by cachesim-convert. The header is rewritten with
+// the final record count on close, so the output must be seekable.
+typedef struct trace_writer {
+    FILE *out;
+    uint32_t flags;
+    uint64_t n_records;
+    uint64_t prev_addr;
+    uint8_t *buf;
+    size_t buf_used;
+    // the header already holds the final count (trace_writer_open_counted)
+    bool counted;
+    uint64_t n_counted;
+} trace_writer_t;
+
+extern int trace_writer_open(trace_writer_t *writer, FILE *out, uint32_t flags);
+// For a known number of records: the header is final from the start, so
+// out may be a pipe. trace_writer_close() fails if a different number of
+// records was appended.
+extern int trace_writer_open_counted(trace_writer_t *writer, FILE *out, uint32_t flags, uint64_t n_records);
+extern int trace_writer_append(trace_writer_t *writer, char rw, uint64_t addr);
+// Append n packed records (see trace_pack()); raw ones are written as is
+extern int trace_writer_append_packed(trace_writer_t *writer, const uint64_t *recs, size_t n);
+extern int trace_writer_close(trace_writer_t *writer);
+
+// Records handed out per trace_reader_next() call
+static const size_t TRACE_BATCH = 4096;
+
+// Reads a trace of any supported format from a file descriptor and hands
+// it out in batches of packed records (see trace_pack()). Regular files are
+// mapped and everything else is read in blocks, so pipes work too. Raw
+// binary records are returned in place without copying. gzip, xz and zstd
+// input (text or binary) is recognised by its magic bytes and decompressed
+// block by block into the reader's buffer.
+typedef struct trace_reader {
+    trace_mapping_t mapping;
+    bool mapped;
+    int fd;
+    // unread input is window[off, len)
+    const uint8_t *window;
+    size_t len;
+    size_t off;
+    bool eof;
+    uint8_t *buf;
+    // binary traces only
+    bool binary;
+    uint32_t flags;
+    uint64_t n_left;
+    uint64_t prev_addr;
+    // decoded records for text and delta traces
+    uint64_t *recs;
+    // set when a malformed binary or compressed trace is detected, or a
+    // text line's address does not fit in 63 bits (bad_addr is set too)
+    bool error;
+    bool bad_addr;
+    // total (decompressed) input bytes consumed so far
+    uint64_t bytes_in;
+    // compressed input is zdata[zoff, zlen): the mapping, or zbuf
+    trace_codec_t codec;
+    trace_decoder_t *decoder;
+    const uint8_t *zdata;
+    uint8_t *zbuf;
+    size_t zlen;
+    size_t zoff;
+    bool zeof;
+    uint64_t bytes_compressed;
+    double decompress_secs;
+} trace_reader_t;
+
+// Returns 0 on success; see trace_reader_strerror() otherwise
+extern int trace_reader_open(trace_reader_t *reader, int fd);
+// Returns the next batch of *n (> 0) records, or NULL at the end of the
+// trace or if reader->error was set.
+extern const uint64_t *trace_reader_next(trace_reader_t *reader, size_t *n);
+extern void trace_reader_close(trace_reader_t *reader);
+// Why trace_reader_open() failed or reader->error was set
+extern const char *trace_reader_strerror(const trace_reader_t *reader);
+
+// Read a whole trace file (any format) into memory as packed records.
+// Returns 0 on success.
+extern int trace_load(const char *path, std::vector<uint64_t> &recs);
+
+// Parses the complete "R 0x..."/"W 0x..." lines of text[0, n) into packed
+// records, stopping early once max_out records are written. A final line
+// without a newline is only parsed when at_eof is set. Returns the number
+// of bytes consumed; *n_out is set to the number of records written.
+// Malformed lines are skipped. *bad_addr is set if any address needs bit
+// 63 (or more), which the packed record has no room for; the records are
+// then not usable.
+extern size_t trace_parse_text(const char *text, size_t n, bool at_eof,
+                               uint64_t *out, size_t max_out, size_t *n_out, bool *bad_addr);
+// Which trace_parse_text() implementation this CPU runs: "avx2", "sse4.2"
+// or "scalar"
+extern const char *trace_parse_text_impl(void);
+
+#endif /* TRACE_HPP */
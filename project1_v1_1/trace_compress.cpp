@@ -0,0 +1,222 @@
+#include "trace_compress.hpp"
+#include <stdlib.h>
+#include <string.h>
+#ifdef TRACE_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TRACE_HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef TRACE_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+struct trace_decoder {
+    trace_codec_t codec;
+    // between streams: the previous one ended and no new one has started
+    bool at_end;
+#ifdef TRACE_HAVE_ZLIB
+    z_stream gz;
+#endif
+#ifdef TRACE_HAVE_LZMA
+    lzma_stream xz;
+#endif
+#ifdef TRACE_HAVE_ZSTD
+    ZSTD_DStream *zstd;
+#endif
+};
+
+trace_codec_t trace_detect_codec(const uint8_t *data, size_t size) {
+    static const uint8_t gzip_magic[] = {0x1f, 0x8b};
+    static const uint8_t xz_magic[] = {0xfd, '7', 'z', 'X', 'Z', 0x00};
+    static const uint8_t zstd_magic[] = {0x28, 0xb5, 0x2f, 0xfd};
+    if (size >= sizeof gzip_magic && !memcmp(data, gzip_magic, sizeof gzip_magic)) {
+        return TRACE_CODEC_GZIP;
+    }
+    if (size >= sizeof xz_magic && !memcmp(data, xz_magic, sizeof xz_magic)) {
+        return TRACE_CODEC_XZ;
+    }
+    if (size >= sizeof zstd_magic && !memcmp(data, zstd_magic, sizeof zstd_magic)) {
+        return TRACE_CODEC_ZSTD;
+    }
+    return TRACE_CODEC_NONE;
+}
+
+const char *trace_codec_name(trace_codec_t codec) {
+    switch (codec) {
+        case TRACE_CODEC_NONE: return "none";
+        case TRACE_CODEC_GZIP: return "gzip";
+        case TRACE_CODEC_XZ: return "xz";
+        case TRACE_CODEC_ZSTD: return "zstd";
+        default: return "unknown";
+    }
+}
+
+bool trace_codec_supported(trace_codec_t codec) {
+    switch (codec) {
+#ifdef TRACE_HAVE_ZLIB
+        case TRACE_CODEC_GZIP: return true;
+#endif
+#ifdef TRACE_HAVE_LZMA
+        case TRACE_CODEC_XZ: return true;
+#endif
+#ifdef TRACE_HAVE_ZSTD
+        case TRACE_CODEC_ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+trace_decoder_t *trace_decoder_open(trace_codec_t codec) {
+    if (!trace_codec_supported(codec)) {
+        return NULL;
+    }
+    trace_decoder_t *decoder = (trace_decoder_t *)calloc(1, sizeof *decoder);
+    if (!decoder) {
+        return NULL;
+    }
+    decoder->codec = codec;
+    bool ok = false;
+    switch (codec) {
+#ifdef TRACE_HAVE_ZLIB
+        case TRACE_CODEC_GZIP:
+            // 15 + 16: gzip wrapper only
+            ok = inflateInit2(&decoder->gz, 15 + 16) == Z_OK;
+            break;
+#endif
+#ifdef TRACE_HAVE_LZMA
+        case TRACE_CODEC_XZ:
+            decoder->xz = LZMA_STREAM_INIT;
+            ok = lzma_stream_decoder(&decoder->xz, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+            break;
+#endif
+#ifdef TRACE_HAVE_ZSTD
+        case TRACE_CODEC_ZSTD:
+            decoder->zstd = ZSTD_createDStream();
+            ok = decoder->zstd && !ZSTD_isError(ZSTD_initDStream(decoder->zstd));
+            break;
+#endif
+        default:
+            break;
+    }
+    if (!ok) {
+        free(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+int trace_decoder_run(trace_decoder_t *decoder, const uint8_t *in, size_t in_len, size_t *in_used,
+                      uint8_t *out, size_t out_len, size_t *out_made) {
+    *in_used = 0;
+    *out_made = 0;
+    switch (decoder->codec) {
+#ifdef TRACE_HAVE_ZLIB
+        case TRACE_CODEC_GZIP: {
+            z_stream &gz = decoder->gz;
+            // zlib counts in uInt, so feed it at most 1 GB at a time
+            const size_t chunk = 1u << 30;
+            // inflate may hold output back after eating all its input, so
+            // keep calling it until the output is full or it is stuck
+            while (*out_made < out_len) {
+                if (decoder->at_end) {
+                    if (*in_used == in_len) {
+                        break;
+                    }
+                    // another gzip member follows
+                    inflateReset(&gz);
+                    decoder->at_end = false;
+                }
+                size_t avail_in = in_len - *in_used < chunk ? in_len - *in_used : chunk;
+                size_t avail_out = out_len - *out_made < chunk ? out_len - *out_made : chunk;
+                gz.next_in = (Bytef *)(in + *in_used);
+                gz.avail_in = (uInt)avail_in;
+                gz.next_out = out + *out_made;
+                gz.avail_out = (uInt)avail_out;
+                int ret = inflate(&gz, Z_NO_FLUSH);
+                *in_used += avail_in - gz.avail_in;
+                *out_made += avail_out - gz.avail_out;
+                if (ret == Z_STREAM_END) {
+                    decoder->at_end = true;
+                } else if (ret == Z_BUF_ERROR) {
+                    // needs more input
+                    break;
+                } else if (ret != Z_OK) {
+                    return 1;
+                }
+            }
+            return 0;
+        }
+#endif
+#ifdef TRACE_HAVE_LZMA
+        case TRACE_CODEC_XZ: {
+            lzma_stream &xz = decoder->xz;
+            xz.next_in = in;
+            xz.avail_in = in_len;
+            xz.next_out = out;
+            xz.avail_out = out_len;
+            // an empty input means the file ended: let the decoder check
+            // that the last stream was complete
+            lzma_ret ret = lzma_code(&xz, in_len ? LZMA_RUN : LZMA_FINISH);
+            *in_used = in_len - xz.avail_in;
+            *out_made = out_len - xz.avail_out;
+            decoder->at_end = ret == LZMA_STREAM_END;
+            return ret != LZMA_OK && ret != LZMA_STREAM_END && ret != LZMA_BUF_ERROR;
+        }
+#endif
+#ifdef TRACE_HAVE_ZSTD
+        case TRACE_CODEC_ZSTD: {
+            ZSTD_inBuffer zin = {in, in_len, 0};
+            ZSTD_outBuffer zout = {out, out_len, 0};
+            while (zout.pos < zout.size) {
+                size_t in_before = zin.pos;
+                size_t out_before = zout.pos;
+                size_t ret = ZSTD_decompressStream(decoder->zstd, &zout, &zin);
+                if (ZSTD_isError(ret)) {
+                    return 1;
+                }
+                if (zin.pos == in_before && zout.pos == out_before) {
+                    break;
+                }
+                // 0 means a frame just finished; the next one may follow
+                decoder->at_end = ret == 0;
+            }
+            *in_used = zin.pos;
+            *out_made = zout.pos;
+            return 0;
+        }
+#endif
+        default:
+            return 1;
+    }
+}
+
+bool trace_decoder_at_end(const trace_decoder_t *decoder) {
+    return decoder->at_end;
+}
+
+void trace_decoder_close(trace_decoder_t *decoder) {
+    if (!decoder) {
+        return;
+    }
+    switch (decoder->codec) {
+#ifdef TRACE_HAVE_ZLIB
+        case TRACE_CODEC_GZIP:
+            inflateEnd(&decoder->gz);
+            break;
+#endif
+#ifdef TRACE_HAVE_LZMA
+        case TRACE_CODEC_XZ:
+            lzma_end(&decoder->xz);
+            break;
+#endif
+#ifdef TRACE_HAVE_ZSTD
+        case TRACE_CODEC_ZSTD:
+            ZSTD_freeDStream(decoder->zstd);
+            break;
+#endif
+        default:
+            break;
+    }
+    free(decoder);
+}
@@ -0,0 +1,35 @@
+#ifndef TRACE_COMPRESS_HPP
+#define TRACE_COMPRESS_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming decompression for compressed traces. Each codec is compiled in
+// only when the Makefile finds its library (TRACE_HAVE_ZLIB,
+// TRACE_HAVE_LZMA, TRACE_HAVE_ZSTD).
+typedef enum trace_codec {
+    TRACE_CODEC_NONE = 0,
+    TRACE_CODEC_GZIP,
+    TRACE_CODEC_XZ,
+    TRACE_CODEC_ZSTD
+} trace_codec_t;
+
+// Identify the codec from the first bytes of a file by its magic number
+extern trace_codec_t trace_detect_codec(const uint8_t *data, size_t size);
+extern const char *trace_codec_name(trace_codec_t codec);
+extern bool trace_codec_supported(trace_codec_t codec);
+
+typedef struct trace_decoder trace_decoder_t;
+
+// NULL if the codec is unsupported or out of memory
+extern trace_decoder_t *trace_decoder_open(trace_codec_t codec);
+// Decompress from in[0, in_len) into out[0, out_len). Sets *in_used and
+// *out_made; concatenated streams (pigz, xz -T, zstd -T) are decoded back to
+// back. Returns 0 on success, nonzero on corrupt input.
+extern int trace_decoder_run(trace_decoder_t *decoder, const uint8_t *in, size_t in_len, size_t *in_used,
+                             uint8_t *out, size_t out_len, size_t *out_made);
+// True when the last stream ended cleanly with no partial stream pending
+extern bool trace_decoder_at_end(const trace_decoder_t *decoder);
+extern void trace_decoder_close(trace_decoder_t *decoder);
+
+#endif /* TRACE_COMPRESS_HPP */
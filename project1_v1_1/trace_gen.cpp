@@ -0,0 +1,303 @@
+#include "trace_gen.hpp"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "cachesim.hpp"
+
+static const char *const KIND_NAMES[] = {"strided", "uniform", "zipf", "chase", "matmul"};
+static const size_t N_KINDS = sizeof KIND_NAMES / sizeof *KIND_NAMES;
+
+// An integer with an optional K, M or G suffix
+static bool parse_size(const char *s, uint64_t *out) {
+    char *end;
+    uint64_t v = strtoull(s, &end, 0);
+    if (end == s) {
+        return false;
+    }
+    unsigned shift = 0;
+    switch (*end) {
+    case 'K': case 'k': shift = 10; end++; break;
+    case 'M': case 'm': shift = 20; end++; break;
+    case 'G': case 'g': shift = 30; end++; break;
+    default: break;
+    }
+    if (*end || (shift && v > (UINT64_MAX >> shift))) {
+        return false;
+    }
+    *out = v << shift;
+    return true;
+}
+
+static bool parse_double(const char *s, double *out) {
+    char *end;
+    *out = strtod(s, &end);
+    return end != s && !*end;
+}
+
+bool trace_gen_parse(const char *text, TraceGenSpec *out, std::string *error) {
+    TraceGenSpec spec;
+    std::string s = text;
+    size_t colon = s.find(':');
+    std::string kind = s.substr(0, colon);
+    size_t k = 0;
+    while (k < N_KINDS && kind != KIND_NAMES[k]) {
+        k++;
+    }
+    if (k == N_KINDS) {
+        *error = "unknown trace kind '" + kind + "' (strided, uniform, zipf, chase, matmul)";
+        return false;
+    }
+    spec.kind = (trace_gen_kind_t)k;
+
+    size_t pos = colon == std::string::npos ? s.size() : colon + 1;
+    while (pos < s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = s.size();
+        }
+        std::string item = s.substr(pos, comma - pos);
+        pos = comma + 1;
+        size_t eq = item.find('=');
+        if (eq == std::string::npos) {
+            *error = "expected key=value, got '" + item + "'";
+            return false;
+        }
+        std::string key = item.substr(0, eq);
+        const char *value = item.c_str() + eq + 1;
+        bool ok;
+        if (key == "n") {
+            ok = parse_size(value, &spec.n);
+        } else if (key == "seed") {
+            ok = parse_size(value, &spec.seed);
+        } else if (key == "writes") {
+            ok = parse_double(value, &spec.writes) && spec.writes >= 0 && spec.writes <= 1;
+        } else if (key == "base") {
+            ok = parse_size(value, &spec.base);
+        } else if (key == "footprint") {
+            ok = parse_size(value, &spec.footprint) && spec.footprint >= 64;
+        } else if (key == "stride") {
+            ok = parse_size(value, &spec.stride) && spec.stride > 0;
+        } else if (key == "theta") {
+            ok = parse_double(value, &spec.theta) && spec.theta > 0;
+        } else if (key == "node") {
+            ok = parse_size(value, &spec.node) && spec.node >= 8;
+        } else if (key == "dim") {
+            ok = parse_size(value, &spec.dim) && spec.dim > 0 && spec.dim <= (1 << 20);
+        } else if (key == "tile") {
+            ok = parse_size(value, &spec.tile);
+        } else {
+            *error = "unknown setting '" + key + "'";
+            return false;
+        }
+        if (!ok) {
+            *error = "bad value for " + key + ": '" + std::string(value) + "'";
+            return false;
+        }
+    }
+
+    uint64_t span = spec.kind == TRACE_GEN_MATMUL ? 3 * spec.dim * spec.dim * 8 : spec.footprint;
+    if (spec.kind == TRACE_GEN_CHASE && spec.node > spec.footprint) {
+        *error = "the footprint must hold at least one node";
+        return false;
+    }
+    if (spec.base > ACCESS_ADDR_MASK || span > ACCESS_ADDR_MASK - spec.base) {
+        *error = "addresses must stay below 2^63";
+        return false;
+    }
+    *out = spec;
+    return true;
+}
+
+static inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x;
+}
+
+TraceGenerator::TraceGenerator(const TraceGenSpec &gen_spec) : spec(gen_spec) {
+    rng = mix64(spec.seed ^ 0x6A09E667F3BCC909ULL);
+    write_threshold = spec.writes >= 1 ? UINT64_MAX : (uint64_t)(spec.writes * 18446744073709551616.0);
+
+    if (spec.kind == TRACE_GEN_ZIPF) {
+        perm_n = spec.footprint / 64;
+    } else if (spec.kind == TRACE_GEN_CHASE) {
+        perm_n = spec.footprint / spec.node;
+    }
+    // 2 * perm_half_bits bits cover perm_n, so cycle walking takes fewer
+    // than four rounds on average
+    perm_half_bits = 1;
+    while (perm_half_bits < 32 && (1ULL << (2 * perm_half_bits)) < perm_n) {
+        perm_half_bits++;
+    }
+    for (int r = 0; r < 4; r++) {
+        perm_keys[r] = random();
+    }
+
+    if (spec.kind == TRACE_GEN_ZIPF) {
+        double n = (double)perm_n;
+        zipf_x1 = zipf_h_integral(1.5) - 1;
+        zipf_hn = zipf_h_integral(n + 0.5);
+        zipf_s = 2 - zipf_h_integral_inverse(zipf_h_integral(2.5) - zipf_h(2));
+    }
+    tile = spec.tile && spec.tile < spec.dim ? spec.tile : spec.dim;
+}
+
+// splitmix64
+uint64_t TraceGenerator::random() {
+    rng += 0x9E3779B97F4A7C15ULL;
+    return mix64(rng);
+}
+
+uint64_t TraceGenerator::below(uint64_t n) {
+    return random() % n;
+}
+
+uint64_t TraceGenerator::permute(uint64_t x) const {
+    const unsigned h = perm_half_bits;
+    const uint64_t mask = (1ULL << h) - 1;
+    do {
+        uint64_t left = x >> h, right = x & mask;
+        for (int r = 0; r < 4; r++) {
+            uint64_t f = mix64(right ^ perm_keys[r]) & mask;
+            uint64_t next = left ^ f;
+            left = right;
+            right = next;
+        }
+        x = (left << h) | right;
+    } while (x >= perm_n);
+    return x;
+}
+
+// log1p(x) / x and expm1(x) / x, accurate near 0
+static double helper1(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+}
+static double helper2(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+}
+
+double TraceGenerator::zipf_h_integral(double x) const {
+    double log_x = log(x);
+    return helper2((1 - spec.theta) * log_x) * log_x;
+}
+
+double TraceGenerator::zipf_h(double x) const {
+    return exp(-spec.theta * log(x));
+}
+
+double TraceGenerator::zipf_h_integral_inverse(double x) const {
+    double t = std::max(x * (1 - spec.theta), -1.0);
+    return exp(helper1(t) * x);
+}
+
+// A rank in [1, perm_n], rank r drawn with probability proportional to
+// r^-theta
+uint64_t TraceGenerator::zipf_rank() {
+    for (;;) {
+        double u = zipf_hn + (random() >> 11) * (1.0 / 9007199254740992.0) * (zipf_x1 - zipf_hn);
+        double x = zipf_h_integral_inverse(u);
+        uint64_t r = (uint64_t)(x + 0.5);
+        r = std::min<uint64_t>(std::max<uint64_t>(r, 1), perm_n);
+        if (r - x <= zipf_s || u >= zipf_h_integral(r + 0.5) - zipf_h((double)r)) {
+            return r;
+        }
+    }
+}
+
+// One reference of the tiled matrix multiply. For each element (i, j) of
+// a C tile: read C[i][j] unless this is the first k tile, read A[i][k] and
+// B[k][j] across the k tile, then write C[i][j].
+uint64_t TraceGenerator::matmul_next() {
+    const uint64_t n = spec.dim;
+    const uint64_t a = spec.base, b = a + n * n * 8, c = b + n * n * 8;
+    for (;;) {
+        switch (phase) {
+        case 0:
+            phase = 1;
+            k = kk;
+            if (kk > 0) {
+                return c + (i * n + j) * 8;
+            }
+            break;
+        case 1:
+            phase = 2;
+            return a + (i * n + k) * 8;
+        case 2:
+            k++;
+            phase = k < std::min(kk + tile, n) ? 1 : 3;
+            return b + ((k - 1) * n + j) * 8;
+        default: {
+            uint64_t addr = (c + (i * n + j) * 8) | ACCESS_WRITE_BIT;
+            phase = 0;
+            if (++j == std::min(jj + tile, n)) {
+                j = jj;
+                if (++i == std::min(ii + tile, n)) {
+                    i = ii;
+                    if ((kk += tile) >= n) {
+                        kk = 0;
+                        if ((jj += tile) >= n) {
+                            jj = 0;
+                            if ((ii += tile) >= n) {
+                                ii = 0;
+                            }
+                        }
+                        i = ii;
+                        j = jj;
+                    }
+                }
+            }
+            return addr;
+        }
+        }
+    }
+}
+
+uint64_t TraceGenerator::write_flag() {
+    return write_threshold && random() < write_threshold ? ACCESS_WRITE_BIT : 0;
+}
+
+// Each record draws its address and then its write flag, so the trace does
+// not depend on how it is split into batches
+size_t TraceGenerator::next(uint64_t *out, size_t max) {
+    size_t m = (size_t)std::min<uint64_t>(max, spec.n - produced);
+    switch (spec.kind) {
+    case TRACE_GEN_STRIDED:
+        for (size_t x = 0; x < m; x++) {
+            out[x] = (spec.base + offset) | write_flag();
+            offset += spec.stride;
+            if (offset >= spec.footprint) {
+                offset %= spec.footprint;
+            }
+        }
+        break;
+    case TRACE_GEN_UNIFORM:
+        for (size_t x = 0; x < m; x++) {
+            uint64_t addr = spec.base + below(spec.footprint / 8) * 8;
+            out[x] = addr | write_flag();
+        }
+        break;
+    case TRACE_GEN_ZIPF:
+        for (size_t x = 0; x < m; x++) {
+            uint64_t addr = spec.base + permute(zipf_rank() - 1) * 64;
+            addr += random() & 56;
+            out[x] = addr | write_flag();
+        }
+        break;
+    case TRACE_GEN_CHASE:
+        for (size_t x = 0; x < m; x++) {
+            out[x] = (spec.base + permute((produced + x) % perm_n) * spec.node) | write_flag();
+        }
+        break;
+    case TRACE_GEN_MATMUL:
+        for (size_t x = 0; x < m; x++) {
+            out[x] = matmul_next();
+        }
+        break;
+    }
+    produced += m;
+    return m;
+}
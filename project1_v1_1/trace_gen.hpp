@@ -0,0 +1,88 @@
+#ifndef TRACE_GEN_HPP
+#define TRACE_GEN_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Synthetic trace kinds
+typedef enum trace_gen_kind {
+    // base + i * stride, wrapping at footprint
+    TRACE_GEN_STRIDED,
+    // 8-byte words drawn uniformly from footprint
+    TRACE_GEN_UNIFORM,
+    // 64-byte blocks of footprint drawn with Zipf(theta) popularity; the hot
+    // blocks are scattered, not adjacent
+    TRACE_GEN_ZIPF,
+    // pointer chasing: one fixed random cycle through the node-sized nodes
+    // of footprint, so every node always has the same successor
+    TRACE_GEN_CHASE,
+    // C = A * B on dim x dim matrices of 8-byte elements, in tile x tile
+    // blocks (tile 0: the naive i-j-k loop), repeated
+    TRACE_GEN_MATMUL,
+} trace_gen_kind_t;
+
+// "KIND[:key=value,...]", e.g. "zipf:n=64M,footprint=1G,theta=0.9,writes=0.2".
+// Sizes and counts take K, M and G suffixes (2^10, 2^20, 2^30).
+struct TraceGenSpec {
+    trace_gen_kind_t kind = TRACE_GEN_STRIDED;
+    // records
+    uint64_t n = 1 << 20;
+    uint64_t seed = 1;
+    // fraction of writes; matmul ignores it (C is written, A and B read)
+    double writes = 0.3;
+    uint64_t base = 0x10000000;
+    uint64_t footprint = 1 << 20;
+    uint64_t stride = 64;
+    double theta = 0.99;
+    uint64_t node = 64;
+    uint64_t dim = 256;
+    uint64_t tile = 0;
+};
+
+// Returns false, with a message in *error, on a malformed spec
+extern bool trace_gen_parse(const char *spec, TraceGenSpec *out, std::string *error);
+
+// Produces the trace of a spec in batches of packed records (trace_pack()).
+// The same spec always gives the same trace.
+class TraceGenerator {
+public:
+    explicit TraceGenerator(const TraceGenSpec &spec);
+    // Up to max records into out; 0 once all spec.n are out
+    size_t next(uint64_t *out, size_t max);
+    uint64_t remaining() const { return spec.n - produced; }
+
+private:
+    uint64_t random();
+    uint64_t below(uint64_t n);
+    uint64_t write_flag();
+    // a bijection on [0, perm_n), a Feistel network with cycle walking
+    uint64_t permute(uint64_t x) const;
+    uint64_t zipf_rank();
+    uint64_t matmul_next();
+    double zipf_h_integral(double x) const;
+    double zipf_h(double x) const;
+    double zipf_h_integral_inverse(double x) const;
+
+    TraceGenSpec spec;
+    uint64_t produced = 0;
+    // strided: offset of the next record into footprint
+    uint64_t offset = 0;
+    uint64_t rng;
+    uint64_t write_threshold;
+
+    uint64_t perm_n = 1;
+    unsigned perm_half_bits = 1;
+    uint64_t perm_keys[4];
+
+    // Zipf by rejection-inversion (Hormann and Derflinger), constant time
+    // and memory for any number of blocks
+    double zipf_x1 = 0, zipf_hn = 0, zipf_s = 0;
+
+    // matmul loop state: tile origin, then the element within the tile
+    uint64_t tile = 0;
+    uint64_t ii = 0, jj = 0, kk = 0, i = 0, j = 0, k = 0;
+    int phase = 0;
+};
+
+#endif /* TRACE_GEN_HPP */
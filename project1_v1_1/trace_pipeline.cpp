@@ -0,0 +1,96 @@
+#include <string.h>
+#include <time.h>
+#include "trace_pipeline.hpp"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Spin briefly, then give up the CPU, so a one-core machine still makes
+// progress
+static void backoff(unsigned &spins) {
+    if (++spins < 64) {
+        return;
+    }
+    std::this_thread::yield();
+}
+
+TracePipeline::TracePipeline(trace_reader_t *reader, unsigned n_slots)
+    : reader(reader), slots(new Slot[n_slots]), n_slots(n_slots), head(0), tail(0), done(false), cancel(false) {
+    // trace_reader_open() already decompressed the first block
+    counters.decode_secs = reader->decompress_secs;
+    producer = std::thread(&TracePipeline::produce, this);
+}
+
+TracePipeline::~TracePipeline() {
+    finish();
+}
+
+void TracePipeline::produce() {
+    size_t t = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        double start = now();
+        unsigned spins = 0;
+        while (t - head.load(std::memory_order_acquire) == n_slots && !cancel.load(std::memory_order_relaxed)) {
+            backoff(spins);
+        }
+        double ready = now();
+        counters.producer_wait_secs += ready - start;
+
+        size_t n;
+        const uint64_t *recs = trace_reader_next(reader, &n);
+        if (recs) {
+            Slot &slot = slots[t % n_slots];
+            memcpy(slot.recs, recs, n * sizeof *recs);
+            slot.n = n;
+            counters.records += n;
+            counters.batches++;
+        }
+        counters.decode_secs += now() - ready;
+        if (!recs || cancel.load(std::memory_order_relaxed)) {
+            break;
+        }
+        tail.store(++t, std::memory_order_release);
+    }
+    counters.bytes_in = reader->bytes_in;
+    counters.bytes_compressed = reader->bytes_compressed;
+    counters.decompress_secs = reader->decompress_secs;
+    done.store(true, std::memory_order_release);
+}
+
+const uint64_t *TracePipeline::next(size_t *n) {
+    size_t h = head.load(std::memory_order_relaxed);
+    double start = now();
+    if (holding) {
+        counters.consume_secs += start - consumer_since;
+        head.store(++h, std::memory_order_release);
+        holding = false;
+    }
+
+    unsigned spins = 0;
+    while (h == tail.load(std::memory_order_acquire)) {
+        // done is set after the last tail store, so recheck before quitting
+        if (done.load(std::memory_order_acquire) && h == tail.load(std::memory_order_acquire)) {
+            counters.consumer_wait_secs += now() - start;
+            return NULL;
+        }
+        backoff(spins);
+    }
+    consumer_since = now();
+    counters.consumer_wait_secs += consumer_since - start;
+    holding = true;
+
+    const Slot &slot = slots[h % n_slots];
+    *n = slot.n;
+    return slot.recs;
+}
+
+void TracePipeline::finish() {
+    if (producer.joinable()) {
+        // stops a producer the consumer quit on early
+        cancel.store(true, std::memory_order_relaxed);
+        producer.join();
+    }
+}
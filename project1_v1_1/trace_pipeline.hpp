@@ -0,0 +1,66 @@
+#ifndef TRACE_PIPELINE_HPP
+#define TRACE_PIPELINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include "trace.hpp"
+
+// Per-stage counters. Busy time is spent decoding (producer) or in the
+// caller between next() calls (consumer); wait time is spent blocked on a
+// full or an empty ring.
+struct PipelineStats {
+    uint64_t records = 0;
+    uint64_t batches = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_compressed = 0;
+    // decode_secs includes decompress_secs for compressed traces
+    double decode_secs = 0;
+    double decompress_secs = 0;
+    double producer_wait_secs = 0;
+    double consume_secs = 0;
+    double consumer_wait_secs = 0;
+};
+
+// Decodes a trace on a background thread. The producer copies batches from
+// a trace_reader_t into a lock-free single-producer/single-consumer ring,
+// and the consumer takes them with next(), which works like
+// trace_reader_next(): a batch stays valid until the following call.
+class TracePipeline {
+public:
+    // reader must be open and must not be touched until finish()
+    TracePipeline(trace_reader_t *reader, unsigned n_slots = 64);
+    ~TracePipeline();
+
+    const uint64_t *next(size_t *n);
+    // Join the producer; afterwards reader->error and stats() are final
+    void finish();
+
+    const PipelineStats &stats() const { return counters; }
+
+private:
+    struct Slot {
+        uint64_t recs[TRACE_BATCH];
+        size_t n;
+    };
+
+    void produce();
+
+    trace_reader_t *reader;
+    std::unique_ptr<Slot[]> slots;
+    size_t n_slots;
+    std::thread producer;
+    PipelineStats counters;
+    double consumer_since = 0;
+    bool holding = false;
+
+    // slots [head, tail) are full; each index is written by one side only
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+    std::atomic<bool> done;
+    std::atomic<bool> cancel;
+};
+
+#endif /* TRACE_PIPELINE_HPP */
@@ -15,6 +15,12 @@ config_flags_l1_l2_markov='-F markov -r 100'
 config_flags_l1_l2_hybrid='-F hybrid -r 100'
 config_flags_l1_l2_markov50='-F markov -r 50'
 config_flags_l1_l2_hybrid50='-F hybrid -r 50'
+# Pairs of flag sets that must print identical statistics
+fast_forward_flags='-f 100000'
+config_pairs=(
+    "-k 1 $fast_forward_flags|$fast_forward_flags"
+    "-D -k 1 $fast_forward_flags|-D $fast_forward_flags"
+)
 
 banner() {
     local message=$1
@@ -70,6 +76,33 @@ generate_stats_and_diff() {
     fi
 }
 
+# Run one benchmark with two sets of flags that should agree exactly, and
+# diff the results against each other instead of a reference output
+generate_pair_and_diff() {
+    local flags_a=$1
+    local flags_b=$2
+    local benchmark=$3
+
+    local out_a="${student_stat_dir}/pair_a_${benchmark}.out"
+    local out_b="${student_stat_dir}/pair_b_${benchmark}.out"
+    printf '==> Running %s with [%s] and [%s]...\n' "$benchmark" "$flags_a" "$flags_b"
+    ./run.sh $flags_a <"traces/$benchmark.trace" >"$out_a"
+    ./run.sh $flags_b <"traces/$benchmark.trace" >"$out_b"
+    if diff -u "$out_a" "$out_b"; then
+        printf 'Matched!\n\n'
+    else
+        printf '\nPlease examine the differences printed above. Benchmark: %s. Flags: [%s] vs [%s]\n\n' "$benchmark" "$flags_a" "$flags_b"
+    fi
+}
+
+main_consistency() {
+    banner "Testing that equivalent configurations agree (e.g. fast-forward with trivial set sampling)..."
+    local pair
+    for pair in "${config_pairs[@]}"; do
+        generate_pair_and_diff "${pair%%|*}" "${pair#*|}" "$spotlight_benchmark"
+    done
+}
+
 main_undergrad() {
     mkdir -p "$student_stat_dir"
 
@@ -85,6 +118,8 @@ main_undergrad() {
     for benchmark in "${plus1_benchmarks[@]}"; do
         generate_stats_and_diff l1_l2_plus1 "$benchmark"
     done
+
+    main_consistency
 }
 
 main_grad() {